@@ -0,0 +1,576 @@
+
+/**
+ *
+ * Arnes de escalamiento para los motores de minimizacion.
+ *
+ * Uso:
+ *      make escala
+ *      arnes [--base ARCHIVO] [--guardar] [--semilla N]
+ *
+ *  Genera automatas aleatorios cada vez mas grandes y los minimiza con cada
+ *  motor disponible: tabla, bits (hasta 64 estados), incremental y externo
+ *  (solo en Linux y macOS). La segunda mitad de los estados de cada automata
+ *  copia a uno de la primera, para que siempre haya clases que juntar. El
+ *  motor "cambios" mide la latencia de editar con el incremental: sobre el
+ *  automata ya minimizado (sin medir) redirige NUM_CAMBIOS_ARNES transiciones
+ *  al azar, refinando despues de cada una, y luego las deshace; su tiempo es
+ *  por cambio.
+ *
+ *  Para cada automata revisa que todos los motores den la misma forma
+ *  canonica, o sea el mismo automata salvo por los nombres de los estados.
+ *  Mide el tiempo de cada motor (el promedio de varias corridas, en la mas
+ *  rapida de RONDAS rondas) y su memoria: lo que aparta de la arena mas las
+ *  filas de sus tablas estaticas que usan los n estados (el automata, el
+ *  Minimizado y, para el incremental, su estado), o lo que mapea el externo.
+ *  Ajusta por minimos cuadrados en escala logaritmica el exponente k de
+ *  tiempo ~ n^k y memoria ~ n^k.
+ *
+ *  El tiempo tambien se da relativo al de tabla con el mismo automata, medido
+ *  en la misma corrida, y eso es lo que se compara con la base: asi no depende
+ *  de que tan rapida sea la maquina. tabla se revisa por su exponente.
+ *
+ *  Opciones:
+ *      --base ARCHIVO  Compara con los resultados guardados en ARCHIVO y
+ *                      termina con 1 si algun motor tarda, relativo a tabla,
+ *                      mas de TOLERANCIA_TIEMPO veces lo de la base en algun
+ *                      tamaño, usa mas memoria que la base, o crece con un
+ *                      exponente mayor al de la base por mas de
+ *                      TOLERANCIA_EXPONENTE.
+ *      --guardar       Escribe los resultados en el archivo de --base, como la
+ *                      nueva base.
+ *      --semilla N     Semilla para generar los automatas (1 por defecto). La
+ *                      base solo sirve con la misma semilla.
+ *
+ *  Siempre termina con 1 si dos motores no dan la misma forma canonica.
+ *
+ *  Se compila incluyendo proyecto01.c con MAX_NUM_ESTADOS=1024 (ver el
+ *  Makefile), asi que sus tiempos no se comparan con los de p01.
+ */
+
+#define P01_SIN_MAIN
+#include "proyecto01.c"
+
+#include <math.h>
+
+enum {
+    ARNES_tabla,
+    ARNES_bits,
+    ARNES_incremental,
+    ARNES_cambios,
+    ARNES_externo,
+
+    NUM_MOTORES_ARNES
+};
+
+static char* g_nombres_motor[NUM_MOTORES_ARNES] = { "tabla", "bits", "incremental", "cambios", "externo" };
+
+#define NUM_SIMBOLOS_ARNES      4
+#define NUM_CAMBIOS_ARNES       64
+#define MOTOR_REFERENCIA        ARNES_tabla
+#define RONDAS                  5       // Cada tiempo es el de la ronda mas rapida: la que menos se interrumpio.
+#define TIEMPO_MINIMO_US        4000    // Cada ronda repite el motor hasta juntar este tiempo.
+#define MIN_REPETICIONES        3
+#define TOLERANCIA_TIEMPO       3.0     // Del tiempo relativo contra la base; la carga varia.
+#define HOLGURA_TIEMPO_US       20.0    // Abajo de esto el tiempo es casi solo ruido.
+#define TOLERANCIA_EXPONENTE    0.5
+#define MAX_MEDIDAS             64
+
+static int g_tamanos[] = { 16, 32, 64, 128, 256, 512, 1024 };
+
+typedef struct Medida_s {
+    int         motor;
+    int         estados;    // Del automata generado, contando el estado error.
+    int         clases;     // Del minimizado; -1 en la base.
+    double      tiempo_us;
+    double      relativo;   // tiempo_us entre el de MOTOR_REFERENCIA con el mismo automata.
+    double      memoria;    // Bytes.
+} Medida;
+
+typedef struct Medidas_s {
+    Medida      m[MAX_MEDIDAS];
+    int         cuenta;
+} Medidas;
+
+// xorshift64. La semilla no puede ser 0.
+static uint32_t aleatorio(uint64_t* s)
+{
+    uint64_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return (uint32_t)(x >> 32);
+}
+
+// Un automata con n estados (contando el error). Cada estado de la segunda
+// mitad copia la fila y el final de uno de la primera, asi que es equivalente
+// a el; la primera mitad es aleatoria y puede ir a cualquier estado.
+static void generar_af(AF* af, int n, uint64_t* semilla, Arena* temp)
+{
+    af_iniciar(af);
+    af->num_estados = n;
+    for ( int a = 0; a < NUM_SIMBOLOS_ARNES; ++a ) {
+        af->en_alfabeto['a' + a] = 1;
+    }
+    int mitad = (n + 1) / 2;
+    for ( int q = 1; q < n; ++q ) {
+        if ( q >= mitad ) {
+            int gemelo = 1 + (int)(aleatorio(semilla) % (uint32_t)(mitad - 1));
+            memcpy(af->tabla[q], af->tabla[gemelo], sizeof(af->tabla[q]));
+            af->finales[q] = af->finales[gemelo];
+            continue;
+        }
+        for ( int a = 0; a < NUM_SIMBOLOS_ARNES; ++a ) {
+            af->tabla[q]['a' + a] = (estado_t)(aleatorio(semilla) % (uint32_t)n);
+        }
+        af->finales[q] = aleatorio(semilla) % 3 == 0;
+    }
+    af_cerrar(af, temp);
+}
+
+#if MEMORIA_EXTERNA
+static void escribir_csv(AF* af, char* path)
+{
+    FILE* fd = fopen(path, "w");
+    if ( !fd ) {
+        panico("No se pudo escribir el automata para el motor externo");
+    }
+    for ( int q = 1; q < af->num_estados; ++q ) {
+        fprintf(fd, "%d", q);
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            int d = af->tabla[q][af->alfabeto[ai]];
+            if ( d ) {
+                fprintf(fd, ", %c,%d", af->alfabeto[ai], d);
+            }
+        }
+        fprintf(fd, ", %d\n", af->finales[q] ? 1 : 0);
+    }
+    if ( fclose(fd) != 0 ) {
+        panico("No se pudo escribir el automata para el motor externo");
+    }
+}
+#endif
+
+typedef struct Cambio_s {
+    int         estado;
+    int         simbolo;
+    int         destino;
+    int         antes;          // Para deshacerlo.
+} Cambio;
+
+// Transiciones al azar entre estados del automata, con simbolos de su alfabeto.
+static void generar_cambios(Cambio* cambios, AF* af, uint64_t* semilla)
+{
+    for ( int i = 0; i < NUM_CAMBIOS_ARNES; ++i ) {
+        Cambio* c = &cambios[i];
+        c->estado = 1 + (int)(aleatorio(semilla) % (uint32_t)(af->num_estados - 1));
+        c->simbolo = af->alfabeto[aleatorio(semilla) % (uint32_t)af->num_simbolos];
+        c->destino = (int)(aleatorio(semilla) % (uint32_t)af->num_estados);
+    }
+}
+
+typedef struct Arnes_s {
+    AF          af;             // El automata generado.
+    Cambio      cambios[NUM_CAMBIOS_ARNES];
+    Minimizado  min;
+    Incremental inc;
+    AF          salida;         // El resultado del motor externo, ya leido.
+    Canonico    referencia;     // La forma canonica del primer motor.
+    Canonico    canonico;
+#if MEMORIA_EXTERNA
+    Externo     ext;
+    char        path[256];
+    char        path_salida[256];
+    char*       dir;
+#endif
+} Arnes;
+
+static int motor_disponible(int motor, int n)
+{
+    switch ( motor ) {
+    case ARNES_bits:    return n <= 64;
+    case ARNES_externo: return MEMORIA_EXTERNA != 0;
+    default:            return 1;
+    }
+}
+
+// Las partes de cada motor que no se miden: copiar el automata a donde el
+// motor lo espera y, para cambios, minimizarlo la primera vez.
+static void preparar_motor(Arnes* a, int motor, Arena* temp)
+{
+    if ( motor == ARNES_incremental || motor == ARNES_cambios ) {
+        a->inc.af = a->af;
+    }
+    if ( motor == ARNES_cambios ) {
+        inc_iniciar(&a->inc, temp);
+    }
+}
+
+// Regresa cuantas operaciones se midieron: 1, o los cambios hechos y deshechos.
+static int correr_motor(Arnes* a, int motor, Arena* temp)
+{
+    switch ( motor ) {
+    case ARNES_tabla: minimizar_tabla(&a->af, &a->min, temp); break;
+    case ARNES_bits:  minimizar_bits(&a->af, &a->min, temp); break;
+    case ARNES_incremental:
+        inc_iniciar(&a->inc, temp);
+        inc_minimizado(&a->inc, &a->min);
+        break;
+    case ARNES_cambios:
+        for ( int i = 0; i < NUM_CAMBIOS_ARNES; ++i ) {
+            Cambio* c = &a->cambios[i];
+            c->antes = a->inc.af.tabla[c->estado][c->simbolo];
+            inc_transicion(&a->inc, c->estado, c->simbolo, c->destino);
+            inc_refinar(&a->inc, c->estado);
+        }
+        for ( int i = NUM_CAMBIOS_ARNES - 1; i >= 0; --i ) {
+            Cambio* c = &a->cambios[i];
+            inc_transicion(&a->inc, c->estado, c->simbolo, c->antes);
+            inc_refinar(&a->inc, c->estado);
+        }
+        return 2 * NUM_CAMBIOS_ARNES;
+#if MEMORIA_EXTERNA
+    case ARNES_externo:
+        ext_minimizar(&a->ext, a->path, a->path_salida, a->dir, MEMORIA_EXTERNA);
+        break;
+#endif
+    }
+    return 1;
+}
+
+// Bytes de las tablas estaticas del motor que corresponden a los n estados
+// del automata. Del incremental se cuentan sus arreglos por estado (los
+// escalares caben en menos de un byte por fila) y las cubetas en uso.
+static double memoria_estatica(Arnes* a, int motor)
+{
+    double n = a->af.num_estados;
+    double af = n * (sizeof(a->af.tabla[0]) + sizeof(a->af.finales[0]));
+    double min = n * (sizeof(a->min.alcanzables[0]) + sizeof(a->min.clase_de[0]) +
+                      sizeof(a->min.representante[0]));
+    size_t fila_inc = (sizeof(Incremental) - sizeof(AF) - sizeof(a->inc.cubeta)) / MAX_NUM_ESTADOS;
+    switch ( motor ) {
+    case ARNES_incremental:
+    case ARNES_cambios:
+        return af + min + n * fila_inc + a->inc.num_cubetas * sizeof(a->inc.cubeta[0]);
+#if MEMORIA_EXTERNA
+    case ARNES_externo:
+        return (double)a->ext.usada;
+#endif
+    default:
+        return af + min;
+    }
+}
+
+// La forma canonica de lo que dejo la ultima corrida del motor.
+static void canonizar_resultado(Arnes* a, int motor, Canonico* c, Arena* temp)
+{
+    if ( motor == ARNES_externo ) {
+        // El resultado ya es minimo, pero hace falta su Minimizado.
+        if ( !cargar_af(&a->salida, a->path_salida, temp) ) {
+            panico("No se pudo leer el resultado del motor externo");
+        }
+        minimizar_tabla(&a->salida, &a->min, temp);
+        canonizar(&a->salida, &a->min, c);
+    } else if ( motor == ARNES_cambios ) {
+        // Deshechos los cambios, tiene que quedar el mismo automata minimo.
+        canonizar(&a->inc.af, &a->min, c);
+    } else {
+        canonizar(&a->af, &a->min, c);
+    }
+}
+
+// Una ronda: repite el motor hasta juntar TIEMPO_MINIMO_US y se queda con el
+// promedio si es el mas rapido hasta ahora. En r->memoria va lo mas que
+// aparto de la arena.
+static void medir_ronda(Arnes* a, Medida* r, Arena* temp)
+{
+    int64_t total = 0;
+    int veces = 0;
+    do {
+        preparar_motor(a, r->motor, temp);
+        arena_reset(temp);
+        temp->high_water = 0;
+        int64_t inicio = sgl_get_time_us();
+        veces += correr_motor(a, r->motor, temp);
+        total += sgl_get_time_us() - inicio;
+        r->memoria = max(r->memoria, (double)temp->high_water);
+        arena_reset(temp);
+    } while ( total < TIEMPO_MINIMO_US || veces < MIN_REPETICIONES );
+    double t = (double)total / veces;
+    if ( r->tiempo_us == 0 || t < r->tiempo_us ) {
+        r->tiempo_us = t;
+    }
+}
+
+// Corre el motor una vez mas, sin medir, para dejar su resultado en `a`, y
+// completa la medida con eso: la memoria estatica y las clases.
+static void terminar_medida(Arnes* a, Medida* r, Arena* temp)
+{
+    preparar_motor(a, r->motor, temp);
+    arena_reset(temp);
+    correr_motor(a, r->motor, temp);
+    arena_reset(temp);
+    if ( r->motor == ARNES_externo ) {
+        r->memoria = 0;
+    }
+    r->memoria += memoria_estatica(a, r->motor);
+    if ( r->motor == ARNES_cambios ) {
+        inc_minimizado(&a->inc, &a->min);
+    }
+    r->clases = a->min.num_clases;
+}
+
+static Medida* buscar_medida(Medidas* ms, int motor, int estados)
+{
+    for ( int i = 0; i < ms->cuenta; ++i ) {
+        if ( ms->m[i].motor == motor && ms->m[i].estados == estados ) {
+            return &ms->m[i];
+        }
+    }
+    return NULL;
+}
+
+// Pendiente de log(y) contra log(n) por minimos cuadrados, con y el tiempo o
+// la memoria. 0 si hay menos de dos puntos.
+static double ajustar_exponente(Medidas* ms, int motor, int de_memoria)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int k = 0;
+    for ( int i = 0; i < ms->cuenta; ++i ) {
+        Medida* m = &ms->m[i];
+        double y = de_memoria ? m->memoria : m->tiempo_us;
+        if ( m->motor != motor || y <= 0 ) {
+            continue;
+        }
+        double lx = log((double)m->estados);
+        double ly = log(y);
+        sx += lx;
+        sy += ly;
+        sxx += lx * lx;
+        sxy += lx * ly;
+        ++k;
+    }
+    double d = k * sxx - sx * sx;
+    return (k < 2 || d == 0) ? 0 : (k * sxy - sx * sy) / d;
+}
+
+static int nombre_de_motor(const char* nombre)
+{
+    for ( int motor = 0; motor < NUM_MOTORES_ARNES; ++motor ) {
+        if ( strcmp(nombre, g_nombres_motor[motor]) == 0 ) {
+            return motor;
+        }
+    }
+    return -1;
+}
+
+// Formato: una linea por medida, "motor estados tiempo_us relativo memoria".
+// Regresa 0 si no se pudo abrir.
+static int leer_base(Medidas* base, char* path)
+{
+    char ventana[TAM_VENTANA];
+    SglLineReader lector;
+    if ( sgl_line_reader_open(&lector, path, ventana, TAM_VENTANA) != 0 ) {
+        return 0;
+    }
+    char* linea;
+    while ( (linea = sgl_line_reader_next(&lector)) != NULL ) {
+        char nombre[32];
+        Medida m = { 0 };
+        if ( linea[0] == '#' || linea[0] == '\0' ) {
+            continue;
+        }
+        if ( sscanf(linea, "%31s %d %lf %lf %lf", nombre, &m.estados, &m.tiempo_us, &m.relativo, &m.memoria) != 5 ||
+             (m.motor = nombre_de_motor(nombre)) < 0 ) {
+            panico("Linea invalida en el archivo de base");
+        }
+        if ( base->cuenta >= MAX_MEDIDAS ) {
+            panico("Demasiadas medidas en el archivo de base");
+        }
+        m.clases = -1;
+        base->m[base->cuenta++] = m;
+    }
+    sgl_line_reader_close(&lector);
+    return 1;
+}
+
+static void guardar_base(Medidas* ms, char* path, uint64_t semilla)
+{
+    FILE* fd = fopen(path, "w");
+    if ( !fd ) {
+        panico("No se pudo escribir el archivo de base");
+    }
+    fprintf(fd, "# Base de `arnes --semilla %" PRIu64 "`. Se rehace con `make escala ARNES=--guardar`.\n", semilla);
+    fprintf(fd, "# motor estados tiempo_us relativo memoria\n");
+    for ( int i = 0; i < ms->cuenta; ++i ) {
+        Medida* m = &ms->m[i];
+        fprintf(fd, "%s %d %.1f %.4f %.0f\n", g_nombres_motor[m->motor], m->estados, m->tiempo_us,
+                m->relativo, m->memoria);
+    }
+    if ( fclose(fd) != 0 ) {
+        panico("No se pudo escribir el archivo de base");
+    }
+}
+
+// Compara contra la base e imprime cada falla. Regresa el numero de fallas.
+static int comparar_con_base(Medidas* ms, Medidas* base)
+{
+    int fallas = 0;
+    for ( int i = 0; i < ms->cuenta; ++i ) {
+        Medida* m = &ms->m[i];
+        Medida* b = buscar_medida(base, m->motor, m->estados);
+        if ( !b ) {
+            continue;
+        }
+        if ( m->relativo > TOLERANCIA_TIEMPO * b->relativo && m->tiempo_us > HOLGURA_TIEMPO_US ) {
+            sgl_log("FALLA: %s con %d estados tarda %.4f veces lo de %s (base %.4f)\n",
+                    g_nombres_motor[m->motor], m->estados, m->relativo,
+                    g_nombres_motor[MOTOR_REFERENCIA], b->relativo);
+            ++fallas;
+        }
+        if ( m->memoria > b->memoria ) {
+            sgl_log("FALLA: %s con %d estados usa %.0f bytes (base %.0f bytes)\n",
+                    g_nombres_motor[m->motor], m->estados, m->memoria, b->memoria);
+            ++fallas;
+        }
+    }
+    for ( int motor = 0; motor < NUM_MOTORES_ARNES; ++motor ) {
+        for ( int de_memoria = 0; de_memoria < 2; ++de_memoria ) {
+            double k = ajustar_exponente(ms, motor, de_memoria);
+            double kb = ajustar_exponente(base, motor, de_memoria);
+            if ( k > kb + TOLERANCIA_EXPONENTE ) {
+                sgl_log("FALLA: la %s de %s crece como n^%.2f (base n^%.2f)\n",
+                        de_memoria ? "memoria" : "tiempo", g_nombres_motor[motor], k, kb);
+                ++fallas;
+            }
+        }
+    }
+    return fallas;
+}
+
+int main(int argc, char** argv)
+{
+    mem_init(TAM_MEMORIA);
+
+    char* path_base = NULL;
+    int guardar = 0;
+    uint64_t semilla = 1;
+    for ( int i = 1; i < argc; ++i ) {
+        if ( strcmp(argv[i], "--base") == 0 && i + 1 < argc ) {
+            path_base = argv[++i];
+        } else if ( strcmp(argv[i], "--guardar") == 0 ) {
+            guardar = 1;
+        } else if ( strcmp(argv[i], "--semilla") == 0 && i + 1 < argc ) {
+            semilla = strtoull(argv[++i], NULL, 10);
+        } else {
+            panico("Uso: arnes [--base ARCHIVO] [--guardar] [--semilla N]");
+        }
+    }
+    if ( semilla == 0 || (guardar && !path_base) ) {
+        panico("--semilla tiene que ser positiva y --guardar necesita --base.");
+    }
+
+    static Arnes a;
+    static Medidas medidas;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+    uint64_t estado_aleatorio = semilla;
+#if MEMORIA_EXTERNA
+    a.dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    snprintf(a.path, sizeof(a.path), "%s/p01_arnes_%d.csv", a.dir, (int)getpid());
+    snprintf(a.path_salida, sizeof(a.path_salida), "%s/p01_arnes_%d_min.csv", a.dir, (int)getpid());
+#endif
+
+    int distintos = 0;
+    sgl_log("%-12s %8s %8s %14s %10s %14s\n", "motor", "estados", "clases", "tiempo (us)", "relativo",
+            "memoria (KB)");
+    for ( int t = 0; t < (int)sgl_array_count(g_tamanos); ++t ) {
+        int n = g_tamanos[t];
+        if ( n > MAX_NUM_ESTADOS ) {
+            break;
+        }
+        generar_af(&a.af, n, &estado_aleatorio, &temp);
+        generar_cambios(a.cambios, &a.af, &estado_aleatorio);
+        arena_reset(&temp);
+#if MEMORIA_EXTERNA
+        escribir_csv(&a.af, a.path);
+#endif
+        // Las rondas van alternando los motores, para que todos, y sobre todo
+        // MOTOR_REFERENCIA, vean la misma carga de la maquina.
+        Medida ronda[NUM_MOTORES_ARNES];
+        for ( int motor = 0; motor < NUM_MOTORES_ARNES; ++motor ) {
+            ronda[motor] = (Medida){ motor, n, 0, 0, 0, 0 };
+        }
+        for ( int r = 0; r < RONDAS; ++r ) {
+            for ( int motor = 0; motor < NUM_MOTORES_ARNES; ++motor ) {
+                if ( motor_disponible(motor, n) ) {
+                    medir_ronda(&a, &ronda[motor], &temp);
+                }
+            }
+        }
+
+        int primero = -1;
+        for ( int motor = 0; motor < NUM_MOTORES_ARNES; ++motor ) {
+            if ( !motor_disponible(motor, n) ) {
+                continue;
+            }
+            if ( medidas.cuenta >= MAX_MEDIDAS ) {
+                panico("Demasiadas medidas");
+            }
+            Medida m = ronda[motor];
+            terminar_medida(&a, &m, &temp);
+            m.relativo = m.tiempo_us / ronda[MOTOR_REFERENCIA].tiempo_us;
+            medidas.m[medidas.cuenta++] = m;
+            sgl_log("%-12s %8d %8d %14.1f %10.3f %14.1f\n", g_nombres_motor[motor], n, m.clases, m.tiempo_us,
+                    m.relativo, m.memoria / 1024);
+
+            Canonico* c = primero < 0 ? &a.referencia : &a.canonico;
+            canonizar_resultado(&a, motor, c, &temp);
+            arena_reset(&temp);
+            if ( primero < 0 ) {
+                primero = motor;
+            } else if ( c->hash != a.referencia.hash || c->num_estados != a.referencia.num_estados ) {
+                sgl_log("FALLA: %s y %s no dan el mismo automata con %d estados\n",
+                        g_nombres_motor[primero], g_nombres_motor[motor], n);
+                ++distintos;
+            }
+        }
+    }
+#if MEMORIA_EXTERNA
+    remove(a.path);
+    remove(a.path_salida);
+#endif
+
+    sgl_log("\n");
+    Medidas base = { 0 };
+    int hay_base = path_base && !guardar && leer_base(&base, path_base);
+    for ( int motor = 0; motor < NUM_MOTORES_ARNES; ++motor ) {
+        if ( !buscar_medida(&medidas, motor, g_tamanos[0]) ) {
+            continue;
+        }
+        sgl_log("%-12s tiempo ~ n^%.2f, memoria ~ n^%.2f", g_nombres_motor[motor],
+                ajustar_exponente(&medidas, motor, 0), ajustar_exponente(&medidas, motor, 1));
+        if ( hay_base ) {
+            sgl_log("  (base n^%.2f, n^%.2f)",
+                    ajustar_exponente(&base, motor, 0), ajustar_exponente(&base, motor, 1));
+        }
+        sgl_log("\n");
+    }
+
+    int fallas = distintos;
+    if ( guardar ) {
+        guardar_base(&medidas, path_base, semilla);
+        sgl_log("Base guardada en %s\n", path_base);
+    } else if ( hay_base ) {
+        fallas += comparar_con_base(&medidas, &base);
+    } else if ( path_base ) {
+        sgl_log("No hay base en %s; no se compara.\n", path_base);
+    }
+
+    mem_deinit();
+    if ( fallas ) {
+        sgl_log("%d fallas\n", fallas);
+        return EXIT_FAILURE;
+    }
+    sgl_log("Sin fallas\n");
+    return EXIT_SUCCESS;
+}
@@ -101,6 +101,7 @@ struct Arena_s {
     // Memory:
     size_t  size;
     size_t  count;
+    size_t  high_water;  // Largest count seen. Not touched by pop or reset.
     uint8_t*     ptr;
 
     // For pushing/popping
@@ -144,6 +145,7 @@ void arena_reset(Arena* arena);
 // Platform-agnostic definitions.
 typedef struct SglMutex_s SglMutex;
 typedef struct SglSemaphore_s SglSemaphore;
+typedef struct SglThread_s SglThread;
 
 int32_t         sgl_cpu_count(void);
 SglSemaphore*   sgl_create_semaphore(int32_t value);
@@ -153,7 +155,9 @@ SglMutex*       sgl_create_mutex(void);
 int32_t         sgl_mutex_lock(SglMutex* mutex);
 int32_t         sgl_mutex_unlock(SglMutex* mutex);
 void            sgl_destroy_mutex(SglMutex* mutex);
-void            sgl_create_thread(void (*thread_func)(void*), void* params);
+SglThread*      sgl_create_thread(void (*thread_func)(void*), void* params);
+int32_t         sgl_join_thread(SglThread* thread);  // Waits for the thread and frees it. Non-zero on error.
+int64_t         sgl_get_time_us(void);  // Monotonic clock, in microseconds.
 
 
 // ====
@@ -169,6 +173,61 @@ char**  sgl_tokenize(char* string, char* separator);
 char*   sgl_strip_whitespace(char* in);
 int32_t sgl_count_lines(char* contents);
 
+// -- In-place variants. These modify their input instead of allocating.
+
+// Returns the next non-empty token in *iter and advances *iter past it. NULL when there are no more tokens.
+char*   sgl_tokenize_inplace(char** iter, char separator);
+char*   sgl_strip_whitespace_inplace(char* in);
+
+// -- Streaming line reader.
+// Reads a file through a fixed-size window provided by the caller, so memory
+// use does not depend on the size of the file. Lines that cross the end of the
+// window are moved to the front before refilling it. A line that does not fit
+// in the window sets `error`.
+//
+// Usage:
+//      SglLineReader reader;
+//      if (sgl_line_reader_open(&reader, path, window, sizeof(window)) == 0) {
+//          char* line;
+//          while ((line = sgl_line_reader_next(&reader)) != NULL) { ... }
+//          sgl_line_reader_close(&reader);
+//      }
+typedef struct SglLineReader_s {
+    FILE*   fd;
+    char*   window;
+    int64_t size;
+    int64_t begin;      // First unread byte in the window.
+    int64_t end;        // One past the last valid byte in the window.
+    int32_t line_number;
+    int32_t eof;
+    int32_t error;
+} SglLineReader;
+
+int32_t sgl_line_reader_open(SglLineReader* reader, const char* path, char* window, int64_t window_size);
+char*   sgl_line_reader_next(SglLineReader* reader);  // Null-terminated line, valid until the next call.
+void    sgl_line_reader_close(SglLineReader* reader);
+
+
+// ====
+// Tracing
+// -- Spans in Chrome's trace event format, for chrome://tracing or Perfetto.
+// ====
+
+// Call sgl_trace_enable() before creating any threads. Every thread created
+// afterwards with sgl_create_thread() gets a span covering its whole life, so
+// join them all with sgl_join_thread() before sgl_trace_write().
+// Spans nest per thread. Names must outlive the trace (string literals).
+//
+// Usage:
+//      sgl_trace_enable();
+//      sgl_trace_begin("parse"); ... sgl_trace_end();
+//      sgl_trace_write("trace.json");
+void    sgl_trace_enable(void);
+int32_t sgl_trace_enabled(void);
+void    sgl_trace_begin(const char* name);
+void    sgl_trace_end(void);
+int32_t sgl_trace_write(const char* path);  // Will return non-zero on error
+
 
 // ====
 // Windows helpers
@@ -216,6 +275,9 @@ void* arena_alloc_bytes(Arena* arena, size_t num_bytes)
     }
     void* result = arena->ptr + arena->count;
     arena->count += num_bytes;
+    if (arena->count > arena->high_water) {
+        arena->high_water = arena->count;
+    }
     return result;
 }
 
@@ -279,12 +341,16 @@ void arena_reset(Arena* arena)
 {
     memset (arena->ptr, 0, arena->count);
     arena->count = 0;
+    arena->num_children = 0;  // Children pushed before the reset are gone too.
 }
 
 // =================================================================================================
 // THREADING
 // =================================================================================================
 
+static int32_t sgli__trace_thread_created(void);
+static void sgli__run_thread(SglThread* thread);
+
 
 int32_t          sgl_cpu_count(void);
 SglSemaphore*    sgl_create_semaphore(int32_t value);
@@ -294,7 +360,9 @@ SglMutex*        sgl_create_mutex(void);
 int32_t          sgl_mutex_lock(SglMutex* mutex);
 int32_t          sgl_mutex_unlock(SglMutex* mutex);
 void             sgl_destroy_mutex(SglMutex* mutex);
-void             sgl_create_thread(void (*thread_func)(void*), void* params);
+SglThread*       sgl_create_thread(void (*thread_func)(void*), void* params);
+int32_t          sgl_join_thread(SglThread* thread);
+int64_t          sgl_get_time_us(void);
 
 // =================================
 // Windows
@@ -400,9 +468,49 @@ void sgl_destroy_mutex(SglMutex* mutex)
     }
 }
 
-void sgl_create_thread(void (*thread_func)(void*), void* params)
+struct SglThread_s {
+    void    (*thread_func)(void*);
+    void*   params;
+    int32_t traced;
+    HANDLE  handle;
+};
+
+static unsigned __stdcall sgli__thread_main(void* param)
+{
+    sgli__run_thread((SglThread*)param);
+    return 0;
+}
+
+SglThread* sgl_create_thread(void (*thread_func)(void*), void* params)
 {
-    _beginthread(thread_func, 0, params);
+    SglThread* thread = (SglThread*)sgl_malloc(sizeof(SglThread));
+    assert(thread);
+    thread->thread_func = thread_func;
+    thread->params = params;
+    thread->traced = sgli__trace_thread_created();
+    thread->handle = (HANDLE)_beginthreadex(NULL, 0, sgli__thread_main, thread, 0, NULL);
+    assert(thread->handle);
+    return thread;
+}
+
+int32_t sgl_join_thread(SglThread* thread)
+{
+    int32_t result = WaitForSingleObject(thread->handle, INFINITE) == WAIT_OBJECT_0 ? 0 : -1;
+    CloseHandle(thread->handle);
+    sgl_free(thread);
+    return result;
+}
+
+int64_t sgl_get_time_us()
+{
+    static LARGE_INTEGER sgli__frequency;
+    if (!sgli__frequency.QuadPart) {
+        QueryPerformanceFrequency(&sgli__frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (int64_t)(counter.QuadPart / sgli__frequency.QuadPart) * 1000000 +
+           (int64_t)(counter.QuadPart % sgli__frequency.QuadPart) * 1000000 / sgli__frequency.QuadPart;
 }
 
 // =================================
@@ -415,6 +523,7 @@ void sgl_create_thread(void (*thread_func)(void*), void* params)
 #elif defined(__linux__) || defined(__MACH__)
 #include <pthread.h>
 #include <semaphore.h>
+#include <time.h>
 #include <unistd.h>
 #if defined(__MACH__)
 #include <fcntl.h>
@@ -506,8 +615,27 @@ void sgl_destroy_mutex(SglMutex* mutex)
     sgl_free(mutex);
 }
 
-void sgl_create_thread(void (*thread_func)(void*), void* params)
+struct SglThread_s {
+    void        (*thread_func)(void*);
+    void*       params;
+    int32_t     traced;
+    pthread_t   handle;
+};
+
+static void* sgli__thread_main(void* param)
+{
+    sgli__run_thread((SglThread*)param);
+    return NULL;
+}
+
+SglThread* sgl_create_thread(void (*thread_func)(void*), void* params)
 {
+    SglThread* thread = (SglThread*)sgl_malloc(sizeof(SglThread));
+    assert(thread);
+    thread->thread_func = thread_func;
+    thread->params = params;
+    thread->traced = sgli__trace_thread_created();
+
     pthread_attr_t attr;
 
     /* Set the thread attributes */
@@ -515,13 +643,28 @@ void sgl_create_thread(void (*thread_func)(void*), void* params)
     {
         assert(!"Not handling thread attribute failure.");
     }
-    //pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
-    pthread_t leaked_thread;
-    if (pthread_create(&leaked_thread, &attr, (void*(*)(void*))(thread_func), params) != 0)
+    if (pthread_create(&thread->handle, &attr, sgli__thread_main, thread) != 0)
     {
         assert (!"God dammit");
     }
+    pthread_attr_destroy(&attr);
+    return thread;
+}
+
+int32_t sgl_join_thread(SglThread* thread)
+{
+    int32_t result = pthread_join(thread->handle, NULL) == 0 ? 0 : -1;
+    sgl_free(thread);
+    return result;
+}
+
+int64_t sgl_get_time_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 // =================================
@@ -529,6 +672,126 @@ void sgl_create_thread(void (*thread_func)(void*), void* params)
 // =================================
 #endif  // Platforms
 
+// =================================================================================================
+// TRACING
+// =================================================================================================
+
+#if defined(_MSC_VER)
+#define SGL_THREAD_LOCAL __declspec(thread)
+#else
+#define SGL_THREAD_LOCAL __thread
+#endif
+
+typedef struct SglTraceEvent_s {
+    const char* name;   // NULL for the end of a span.
+    int64_t     time_us;
+    int32_t     thread_id;
+} SglTraceEvent;
+
+static struct {
+    int32_t         enabled;
+    SglMutex*       mutex;
+    SglTraceEvent*  events;     // (stretchy buffer)
+    int32_t         num_threads;
+    int32_t         live_threads;   // Traced threads whose span is still open.
+} sgli__trace;
+
+static SGL_THREAD_LOCAL int32_t sgli__trace_thread_id;  // 0 until the thread records something.
+
+void sgl_trace_enable()
+{
+    if (!sgli__trace.enabled) {
+        sgli__trace.mutex = sgl_create_mutex();
+        sgli__trace.enabled = sgli__trace.mutex != NULL;
+    }
+}
+
+int32_t sgl_trace_enabled()
+{
+    return sgli__trace.enabled;
+}
+
+static void sgli__trace_event(const char* name)
+{
+    if (!sgli__trace.enabled) {
+        return;
+    }
+    int64_t now = sgl_get_time_us();
+    sgl_mutex_lock(sgli__trace.mutex);
+    if (!sgli__trace_thread_id) {
+        sgli__trace_thread_id = ++sgli__trace.num_threads;
+    }
+    SglTraceEvent event = { name, now, sgli__trace_thread_id };
+    sb_push(sgli__trace.events, event);
+    sgl_mutex_unlock(sgli__trace.mutex);
+}
+
+void sgl_trace_begin(const char* name)
+{
+    sgli__trace_event(name);
+}
+
+void sgl_trace_end()
+{
+    sgli__trace_event(NULL);
+}
+
+// Called by sgl_create_thread() before starting the thread. Returns whether
+// the thread gets a span.
+static int32_t sgli__trace_thread_created(void)
+{
+    if (!sgli__trace.enabled) {
+        return 0;
+    }
+    sgl_mutex_lock(sgli__trace.mutex);
+    sgli__trace.live_threads += 1;
+    sgl_mutex_unlock(sgli__trace.mutex);
+    return 1;
+}
+
+// Body of every thread. The span ends before the thread does, so once
+// sgl_join_thread() returns its events are all in the buffer.
+static void sgli__run_thread(SglThread* thread)
+{
+    if (thread->traced) {
+        sgl_trace_begin("thread");
+    }
+    thread->thread_func(thread->params);
+    if (thread->traced) {
+        sgl_trace_end();
+        sgl_mutex_lock(sgli__trace.mutex);
+        sgli__trace.live_threads -= 1;
+        sgl_mutex_unlock(sgli__trace.mutex);
+    }
+}
+
+int32_t sgl_trace_write(const char* path)
+{
+    FILE* fd = fopen(path, "w");
+    if (!fd) {
+        return 1;
+    }
+    sgl_mutex_lock(sgli__trace.mutex);
+    // Every traced thread must be joined by now, or its span would be left open.
+    assert(sgli__trace.live_threads == 0);
+    int64_t start = sb_count(sgli__trace.events) ? sgli__trace.events[0].time_us : 0;
+    fprintf(fd, "{\"traceEvents\":[\n");
+    for (int32_t i = 0; i < sb_count(sgli__trace.events); ++i) {
+        SglTraceEvent* e = &sgli__trace.events[i];
+        if (e->name) {
+            fprintf(fd, "{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%" PRId64 ",\"pid\":1,\"tid\":%d}",
+                    e->name, e->time_us - start, e->thread_id);
+        } else {
+            fprintf(fd, "{\"ph\":\"E\",\"ts\":%" PRId64 ",\"pid\":1,\"tid\":%d}",
+                    e->time_us - start, e->thread_id);
+        }
+        fprintf(fd, i + 1 < sb_count(sgli__trace.events) ? ",\n" : "\n");
+    }
+    fprintf(fd, "]}\n");
+    sgl_mutex_unlock(sgli__trace.mutex);
+    return fclose(fd) != 0;
+}
+
 // =================================================================================================
 // IO
 // =================================================================================================
@@ -643,6 +906,98 @@ char* sgl_strip_whitespace(char* in)
     return begin;
 }
 
+char* sgl_tokenize_inplace(char** iter, char separator)
+{
+    char* tok = *iter;
+    while (*tok == separator) {  // Skip empty tokens, like sgl_tokenize
+        ++tok;
+    }
+    if (*tok == '\0') {
+        *iter = tok;
+        return NULL;
+    }
+    char* end = tok;
+    while (*end != '\0' && *end != separator) {
+        ++end;
+    }
+    if (*end != '\0') {
+        *end++ = '\0';
+    }
+    *iter = end;
+    return tok;
+}
+
+char* sgl_strip_whitespace_inplace(char* in)
+{
+    while (isspace((unsigned char)*in)) {
+        ++in;
+    }
+    char* end = in + strlen(in);
+    while (end > in && isspace((unsigned char)*(end - 1))) {
+        *--end = '\0';
+    }
+    return in;
+}
+
+int32_t sgl_line_reader_open(SglLineReader* reader, const char* path, char* window, int64_t window_size)
+{
+    memset(reader, 0, sizeof(SglLineReader));
+    reader->fd = fopen(path, "rb");
+    if (!reader->fd) {
+        fprintf(stderr, "ERROR: couldn't open %s\n", path);
+        return -1;
+    }
+    reader->window = window;
+    reader->size = window_size;
+    return 0;
+}
+
+char* sgl_line_reader_next(SglLineReader* reader)
+{
+    for (;;) {
+        char* begin = reader->window + reader->begin;
+        int64_t pending = reader->end - reader->begin;
+        char* newline = (char*)memchr(begin, '\n', (size_t)pending);
+        if (newline) {
+            *newline = '\0';
+            reader->begin = (newline - reader->window) + 1;
+            reader->line_number++;
+            return begin;
+        }
+        if (reader->eof) {
+            if (pending > 0) {  // Last line, without a newline.
+                reader->window[reader->end] = '\0';
+                reader->begin = reader->end;
+                reader->line_number++;
+                return begin;
+            }
+            return NULL;
+        }
+        // Keep one byte for the terminating zero of the last line.
+        if (pending >= reader->size - 1) {
+            reader->error = 1;
+            return NULL;
+        }
+        // Move the partial line to the front and refill.
+        memmove(reader->window, begin, (size_t)pending);
+        reader->begin = 0;
+        reader->end = pending;
+        size_t read = fread(reader->window + reader->end, 1, (size_t)(reader->size - 1 - reader->end), reader->fd);
+        if (read == 0) {
+            reader->eof = 1;
+        }
+        reader->end += (int64_t)read;
+    }
+}
+
+void sgl_line_reader_close(SglLineReader* reader)
+{
+    if (reader->fd) {
+        fclose(reader->fd);
+    }
+    memset(reader, 0, sizeof(SglLineReader));
+}
+
 int sgl_is_number(char* s)
 {
     int ok = 1;
@@ -692,3 +1047,8 @@ void sgl_win32_log(char *format, ...)
 
 // HISTORY
 // 2015-09-25 -- Added LIBSERG_IMPLEMENTATION macro, sgl_split_lines()
+// 2026-10-18 -- Added SglLineReader, sgl_tokenize_inplace(), sgl_strip_whitespace_inplace()
+// 2026-10-18 -- Added sgl_get_time_us(). arena_reset() also forgets pushed children.
+// 2026-10-18 -- Added tracing (sgl_trace_*) with Chrome trace event output.
+// 2026-10-18 -- Arena tracks its high_water mark.
+// 2026-10-18 -- sgl_create_thread() returns an SglThread for sgl_join_thread().
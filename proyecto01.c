@@ -15,15 +15,123 @@
  *
  *  Donde:
  *      ESTADO:     numero entero positivo. Denotando el estado. -1 para el estado error, pero no es necesario
- *      ENTRADA:    Caracter en ASCII (un byte)
+ *      ENTRADA:    Caracter en ASCII (un byte), o un rango o simbolo de Unicode (ver abajo)
  *      ESTADO:     Resultado de la función de transición
  *      FINAL:      0 para no-final. 1 para final.
  *
+ *  Automatas no deterministas (AFN):
+ *  - Un estado puede tener varias transiciones con la misma entrada,
+ *    repitiendo la entrada:  1, a,2, a,3, 0
+ *  - La entrada `eps` es una transicion epsilon:  1, eps,2, a,3, 0
+ *  Si el archivo tiene alguna de estas, se determiniza con la construccion de
+ *  subconjuntos antes de minimizar.
+ *
+ *  Rangos y Unicode:
+ *  - La entrada puede ser un rango DESDE-HASTA:  1, a-z,2, 0-9,3, 0
+ *  - Los simbolos pueden ser cualquier punto de codigo, escritos como
+ *    caracter UTF-8 (é) o como U+HHHH (U+002C para la coma).
+ *  Con rangos, las cadenas (--probar, --orden perfil:) se leen como UTF-8, y
+ *  el alfabeto se parte en intervalos en lugar de caracteres: la tabla tiene
+ *  una columna por intervalo, no por simbolo. Ver "Rangos".
+ *
  *
  *  Regresa el automata minimizado en formato texto.
+ *
+ *
+ * Uso:
+ *      p01 [opciones] [archivo.csv ...]
+ *
+ *  Sin archivos, procesa af0.csv y af1.csv.
+ *
+ *  Opciones:
+ *      --pipeline      Lee, interpreta, minimiza e imprime en hilos separados,
+ *                      para que la lectura del siguiente archivo se traslape
+ *                      con la minimizacion del actual.
+ *      --cache DIR     Guarda los resultados en DIR y los reusa cuando el
+ *                      mismo automata se vuelve a minimizar.
+ *      --cache-limite BYTES
+ *                      Tamaño maximo del directorio de cache (16 MB por defecto).
+ *      --canonico      Imprime tambien la forma canonica del automata minimizado
+ *                      y su hash. Dos automatas aceptan el mismo lenguaje si y
+ *                      solo si tienen la misma forma canonica.
+ *      --dedup         Para cada archivo cuyo lenguaje ya se vio en un archivo
+ *                      anterior, solo indica con cual es igual.
+ *      --motor tabla|bits
+ *                      Algoritmo para minimizar. `tabla` llena la tabla de
+ *                      estados distinguibles; `bits` usa mascaras de 64 bits y
+ *                      solo sirve con hasta 64 estados. Por defecto se usa
+ *                      `bits` cuando el automata cabe.
+ *      --probar CADENA Ejecuta el automata minimizado con CADENA y dice si la
+ *                      acepta. Se puede repetir.
+ *      --regex EXPRESION
+ *                      Procesa tambien la expresion regular, construyendo el
+ *                      automata con derivadas. Se puede repetir. Ver
+ *                      "Expresiones regulares".
+ *      --perf          Al final, imprime el tiempo de cada etapa y los
+ *                      contadores del procesador (ciclos, instrucciones,
+ *                      fallos de cache y de saltos) si el sistema los da.
+ *      --traza ARCHIVO Escribe en ARCHIVO una traza de las etapas y los hilos
+ *                      en el formato de Chrome (chrome://tracing, Perfetto).
+ *      --orden bfs|dfs|perfil:ARCHIVO
+ *                      Renumera los estados del automata minimizado para que
+ *                      los que se visitan juntos queden juntos en la tabla: en
+ *                      orden de BFS o DFS desde q0, o siguiendo las
+ *                      transiciones mas usadas al ejecutar las cadenas de
+ *                      ARCHIVO (una por linea). El estado error va al final.
+ *
+ *  El numero maximo de estados se puede cambiar al compilar con
+ *  -DMAX_NUM_ESTADOS=N. Los estados se guardan en el entero mas angosto donde
+ *  caben (8, 16 o 32 bits).
+ *
+ *      p01 --emitir-c NOMBRE [--orden ...] archivo.csv [salida.h]
+ *
+ *  Escribe un header de C con el automata minimizado en tablas constantes y
+ *  una funcion NOMBRE_acepta(). Ver "Tablas en C".
+ *
+ *      p01 --servidor [SOCKET]
+ *
+ *  Se queda vivo minimizando los automatas que le mandan en marcos por la
+ *  entrada estandar, o por las conexiones al socket Unix SOCKET. Termina con
+ *  SIGTERM o SIGINT, despues de contestar lo que ya leyo. Ver "Servidor".
+ *
+ *      p01 --equiv A.csv B.csv
+ *
+ *  Dice si A y B aceptan el mismo lenguaje sin minimizarlos. Si no, da una
+ *  cadena que uno acepta y el otro no. Termina con 0 si son equivalentes y 1
+ *  si no.
+ *
+ *      p01 --producto inter|union|dif [opciones] A.csv B.csv [...]
+ *
+ *  Minimiza la interseccion, la union o la diferencia (A - B - ...) de los
+ *  automatas, sin construir el producto completo. Ver "Producto".
+ *
+ *      p01 --patrones [--entrada ARCHIVO] [opciones] A.csv B.csv [...]
+ *
+ *  Junta los automatas en uno solo cuyos estados finales recuerdan que
+ *  automatas (patrones) aceptan, y lo minimiza sin mezclar estados con
+ *  patrones distintos. Con --entrada, ejecuta cada linea de ARCHIVO una sola
+ *  vez y dice que patrones la aceptan.
+ *
+ *      p01 --externo [--memoria MB] [--tmp DIR] archivo.csv salida.csv
+ *
+ *  Minimiza un automata determinista que no cabe en memoria y escribe el
+ *  resultado en salida.csv, en el mismo formato. No tiene limite de estados.
+ *  --memoria es el presupuesto para ordenar (256 MB por defecto) y --tmp el
+ *  directorio de los archivos temporales ($TMPDIR o /tmp). Ver "Minimizacion
+ *  en memoria externa".
+ *
+ *      p01 --incremental archivo.csv cambios.txt
+ *
+ *  Minimiza el automata y luego aplica los cambios uno por uno, actualizando
+ *  las clases sin volver a minimizar todo. Ver "Minimizacion incremental".
  */
 
 
+// Con -std=c99, glibc solo declara syscall() (para perf_event_open) si se pide.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 // Esto no es necesario. Pero lo estoy poniendo por si usar malloc sin free =)
 //
 // Buffer, mem_push, mem_init, y mem_deinit crean una zona de memoria para
@@ -31,6 +139,8 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <setjmp.h>
+#include <stdarg.h>
 typedef struct Buffer_s {
     size_t sz;
     size_t c;
@@ -45,9 +155,8 @@ void* mem_push(size_t n)
     g_buffer.c += n;
     return ptr;
 }
-static void mem_init()
+static void mem_init(size_t sz)
 {
-    size_t sz = 64 * 1024 * 1024;  // 64 megas para todo el programa..
 
     g_buffer.sz = sz;
     g_buffer.c = 0;
@@ -70,13 +179,94 @@ static void mem_deinit()
 #define LIBSERG_IMPLEMENTATION
 #include "libserg.h"
 
-#define MAX_ALFABETO NUM_ASCII_CHARS
+#ifndef MAX_NUM_ESTADOS
 #define MAX_NUM_ESTADOS 64
+#endif
 #define NUM_ASCII_CHARS 128
 
-static int g_AF[MAX_NUM_ESTADOS][MAX_ALFABETO];
-static char g_alfabeto[NUM_ASCII_CHARS];
-static int g_finales[MAX_NUM_ESTADOS];
+// Columnas de la tabla de un AF: los caracteres ASCII, o con rangos los
+// intervalos del alfabeto, que pueden ser mas.
+#ifndef MAX_COLUMNAS
+#define MAX_COLUMNAS 256
+#endif
+#if MAX_COLUMNAS < NUM_ASCII_CHARS
+#error "MAX_COLUMNAS tiene que alcanzar para los caracteres ASCII"
+#endif
+
+// Tipo de los estados en las tablas de transiciones: el entero mas angosto
+// donde caben MAX_NUM_ESTADOS estados.
+#if MAX_NUM_ESTADOS <= 256
+typedef uint8_t estado_t;
+#elif MAX_NUM_ESTADOS <= 65536
+typedef uint16_t estado_t;
+#else
+typedef uint32_t estado_t;
+#endif
+
+#define EPSILON -1
+#define ENTRADA_RANGO -2  // Solo mientras se lee una linea.
+
+// Una transicion que no cabe en la tabla de un AF: epsilon, o una entrada que
+// ya tenia otro destino.
+typedef struct Transicion_s {
+    int estado;
+    int entrada;    // EPSILON o un caracter.
+    int destino;
+} Transicion;
+
+// Una transicion por un rango de puntos de codigo, mientras se lee el archivo.
+typedef struct Rango_s {
+    int         estado;
+    uint32_t    desde;
+    uint32_t    hasta;
+    int         destino;  // 0 si no va a ningun lado; el rango solo entra al alfabeto.
+} Rango;
+
+// Un automata finito determinista. El estado 0 es el estado error.
+typedef struct AF_s {
+    estado_t tabla[MAX_NUM_ESTADOS][MAX_COLUMNAS];
+    int  finales[MAX_NUM_ESTADOS];
+    char en_alfabeto[MAX_COLUMNAS];
+    Transicion* extras;  // (stretchy buffer) Si no esta vacio, el archivo es un AFN.
+    int  estados_afn;    // Si se determinizo, cuantos estados tenia el AFN. Si no, 0.
+    Rango* rangos;       // (stretchy buffer) Transiciones por rango o fuera de ASCII.
+
+    // Si hubo rangos, las columnas de la tabla son intervalos de puntos de
+    // codigo en lugar de caracteres: la columna a es [desde[a], hasta[a]].
+    int      num_intervalos;  // 0 si las columnas son caracteres ASCII.
+    uint32_t desde[MAX_COLUMNAS];
+    uint32_t hasta[MAX_COLUMNAS];
+
+    // Se llenan con af_cerrar() despues de interpretar el archivo.
+    int  alfabeto[MAX_COLUMNAS];     // Las columnas en orden.
+    int  num_simbolos;
+    int  num_estados;                // Uno mas que el estado mas grande mencionado.
+} AF;
+
+// El resultado de minimizar un AF.
+typedef struct Minimizado_s {
+    int alcanzables[MAX_NUM_ESTADOS];    // En el orden en que se encontraron.
+    int num_alcanzables;
+    int clase_de[MAX_NUM_ESTADOS];       // -1 para estados no alcanzables.
+    int representante[MAX_NUM_ESTADOS];  // El primer estado alcanzable de cada clase.
+    int num_clases;
+    int clase_error;                     // -1 si el estado error no es alcanzable.
+} Minimizado;
+
+// Algoritmos para minimizar.
+enum {
+    MOTOR_auto,
+    MOTOR_tabla,
+    MOTOR_bits
+};
+
+// Orden de los estados del automata minimizado.
+enum {
+    ORDEN_descubrimiento,
+    ORDEN_bfs,
+    ORDEN_dfs,
+    ORDEN_perfil
+};
 
 // Maquina de estados para interpretar las lineas de los archivos csv
 enum {
@@ -86,8 +276,23 @@ enum {
     PARSE_final
 };
 
+#if defined(_MSC_VER)
+#define HILO_LOCAL __declspec(thread)
+#else
+#define HILO_LOCAL __thread
+#endif
+
+// Si un hilo pone g_rescate, panico() regresa ahi con longjmp en lugar de
+// terminar el programa. Lo usa el servidor para contestar con el error.
+static HILO_LOCAL jmp_buf* g_rescate;
+static HILO_LOCAL char* g_mensaje_panico;
+
 void panico(char* m)
 {
+    if ( g_rescate ) {
+        g_mensaje_panico = m;
+        longjmp(*g_rescate, 1);
+    }
     sgl_log("%s\n", m);
     exit(EXIT_FAILURE);
 }
@@ -98,347 +303,5109 @@ void panico(char* m)
 #define max(a, b) ( (a) > (b) ) ? a : b
 #endif
 
-// Funcion extra de ayuda.
-static int sb_find(int* a, int e)
-{
-    for(int i = 0; i < sb_count((a)); ++i) {
-        if (a[i] == e)
-            return 1;
-    }
-    return 0;
-}
-
-static void marcar_distinguibles(int* tabla, int p, int q)
+// La tabla de pares es de n por n, con n el numero de estados del automata.
+static void marcar_distinguibles(uint8_t* tabla, int n, int p, int q)
 {
     int M = max(p, q);
     int m = min(p, q);
-    tabla[m * MAX_NUM_ESTADOS + M] = 1;
+    tabla[m * n + M] = 1;
 }
 
-static int son_distinguibles(int* tabla, int p, int q)
+static int son_distinguibles(uint8_t* tabla, int n, int p, int q)
 {
     if ( p == q ) {
         return 0;
     }
     int M = max(p, q);
     int m = min(p, q);
-    int res = tabla[m * MAX_NUM_ESTADOS + M];
+    int res = tabla[m * n + M];
 
     return res;
 }
 
-int main(int argc, char** argv)
+#if defined(_MSC_VER)
+#include <intrin.h>
+static int bit_menor(uint64_t x)
+{
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+}
+static int contar_bits(uint64_t x)
+{
+    return (int)__popcnt64(x);
+}
+#else
+static int bit_menor(uint64_t x)
 {
-    mem_init();
+    return __builtin_ctzll(x);
+}
+static int contar_bits(uint64_t x)
+{
+    return __builtin_popcountll(x);
+}
+#endif
 
-    static char* test_fa [] = {
-        "af0.csv",
-        "af1.csv",
-    };
+// Lo mas grande que usa un paso es la determinizacion: un conjunto de
+// MAX_NUM_ESTADOS bits por cada estado y simbolo.
+#define TAM_ARENA_HILO (1024 * 1024 + 20 * (size_t)MAX_NUM_ESTADOS * MAX_NUM_ESTADOS)
+#define TAM_MEMORIA (64 * 1024 * 1024 + 4 * TAM_ARENA_HILO)
 
+// Crea una arena para un hilo. Solo se debe llamar desde el hilo principal,
+// porque mem_push no es seguro entre hilos.
+static Arena crear_arena(size_t sz)
+{
+    return arena_init(mem_push(sz), sz);
+}
 
-    for (int32_t i = 0; i < sgl_array_count(test_fa); ++i) {
-        int64_t read = 0;
-        // -- Nuevo archivo:
-        // Inicializar el automata finito para dejarlo en valores invalidos, antes de cargar el archivo.
-        memset(g_AF, 0, sizeof(int)*MAX_NUM_ESTADOS * MAX_ALFABETO);
-        memset(g_alfabeto, 0, NUM_ASCII_CHARS);
-        memset(g_finales, -1, sizeof(int) * MAX_NUM_ESTADOS);
-
-        sgl_log("\n\n***** Procesando archivo %s *****\n", test_fa[i]);
-
-        char* contents = sgl_slurp_file(test_fa[i], &read);
-        if (read) {
-            int32_t num_lines;
-            char** lines = sgl_split_lines(contents, &num_lines);
-            if (lines) {
-                // Ahora interpretamos la linea actual para llenar nuestra tabla.
-                // Primera linea, llenar los contadores
-                for (int32_t line_i = 0; line_i < num_lines; ++line_i) {
-                    if ( lines[line_i][0] == '#' ) {
-                        // Es un comentario.
-                        continue;
-                    }
-                    int parse_state = PARSE_estado;
-                    char** toks = sgl_tokenize(lines[line_i], ",");
-                    int estado = -1;
-                    char entrada_actual = 0;
-                    for (int tok_i = 0; tok_i < sb_count(toks); ++tok_i) {
-                        char* tok = sgl_strip_whitespace(toks[tok_i]);
-
-                        switch (parse_state) {
-                        case PARSE_estado: {
-                                if (!sgl_is_number(tok)) {
-                                    panico("El estado no se define correctamente.");
-                                }
-                                estado = atoi(tok);
-                                if ( estado <= 0 || estado >= MAX_NUM_ESTADOS ) {
-                                    panico("Estado invalido\n");
-                                }
-                                if (line_i == 0 && estado != 1) {
-                                    panico("El primer estado tiene que ser 1");
-                                }
-                                parse_state = PARSE_entrada;
-                                break;
-                            }
-                        case PARSE_entrada: {
-                            if ( sgl_is_number(tok) ) {
-                                // Al recibir un numbero en lugar de una letra, asumimos que es final
-                                int final = atoi(tok);
-                                if (final == 0 || final == 1 ) {
-                                    g_finales[estado] = final;
-                                    parse_state = PARSE_final;
-                                } else {
-                                    panico("Definicion de final tiene que ser 0 o 1.");
-                                }
-                            } else if (strlen(tok) == 1){
-                                g_alfabeto[tok[0]] = 1;  // Marcar este caracter como "en el alfabeto"
-                                entrada_actual = tok[0];
-                                parse_state = PARSE_trans;
-                            } else {
-                                panico("entrada no bien definida (debe ser un caracter ascii no numerico)");
-                            }
-                            break;
-                        }
-                        case PARSE_trans: {
-                            if ( !sgl_is_number(tok) ) {
-                                panico("Las transiciones deben ser numeros positivos (estados).");
-                            } else {
-                                int e = atoi(tok);
-                                if (e > 0) {
-                                    g_AF[estado][entrada_actual] = e;
-                                }
-                                parse_state = PARSE_entrada;
-                            }
-                            break;
-                        }
-                        case PARSE_final: {
-                            panico("Mas datos en el archivo de los esperados");
-                            break;
-                        }
-                        }
-                    }
-                }
+// FNV-1a de 64 bits.
+#define FNV_BASE    14695981039346656037ULL
+#define FNV_PRIMO   1099511628211ULL
+
+static uint64_t fnv(uint64_t h, const void* datos, size_t n)
+{
+    const uint8_t* bytes = (const uint8_t*)datos;
+    for ( size_t i = 0; i < n; ++i ) {
+        h ^= bytes[i];
+        h *= FNV_PRIMO;
+    }
+    return h;
+}
 
-                // Marcar estado error como no-final.
-                g_finales[0] = 0;
+static uint64_t fnv_entero(uint64_t h, int32_t v)
+{
+    return fnv(h, &v, sizeof(v));
+}
 
-                // Llenar el alfabeto de esta máquina:
-                char* alfabeto = NULL;
-                int c_alfabeto = 0;
-                for(int ai = 0; ai < NUM_ASCII_CHARS; ++ai) {
-                    if (g_alfabeto[ai] == 1) {
-                        c_alfabeto++;
-                        sb_push(alfabeto, (char)ai);
-                    }
-                }
+// ==== Medicion
+//
+// Con --perf se mide cada etapa (lectura, alcanzables, punto fijo, clases y
+// salida): el tiempo y, en Linux, los contadores del procesador que da
+// perf_event_open (ciclos, instrucciones, fallos de cache y fallos de
+// prediccion de saltos). Los contadores son del hilo que los abre, asi que
+// cada hilo abre los suyos la primera vez que mide y el pipeline tambien se
+// mide bien. Si el sistema no deja abrirlos (perf_event_paranoid, o una
+// maquina virtual sin contadores) solo se reporta el tiempo.
+//
+// Con --traza, cada etapa es ademas un intervalo en la traza de libserg.
 
-                // Output del alfabeto del automata:
-                sgl_log("El alfabeto es: ");
-                for (int ai = 0; ai < c_alfabeto; ++ai) {
-                    sgl_log("%c", alfabeto[ai]);
-                    if (ai < c_alfabeto - 1) {
-                        sgl_log(", ");
-                    } else {
-                        sgl_log("\n");
-                    }
-                }
+enum {
+    ETAPA_lectura,
+    ETAPA_alcanzables,
+    ETAPA_punto_fijo,
+    ETAPA_clases,
+    ETAPA_salida,
+
+    NUM_ETAPAS
+};
 
+#define NUM_CONTADORES 4
+
+typedef struct Medicion_s {
+    int         perf;           // --perf
+    int         traza;          // --traza
+    int         contadores;     // Algun hilo pudo abrir los contadores.
+    SglMutex*   mutex;
+    int64_t     veces[NUM_ETAPAS];
+    uint64_t    total[NUM_ETAPAS][1 + NUM_CONTADORES];  // Microsegundos y luego los contadores.
+} Medicion;
+
+static Medicion g_medicion;
+
+static HILO_LOCAL int g_perf_fd;  // 0 si no se ha intentado abrir, -1 si no se pudo, o fd + 1.
+static HILO_LOCAL uint64_t g_inicio_etapa[NUM_ETAPAS][1 + NUM_CONTADORES];
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+// Abre los contadores como un grupo, para leerlos todos juntos del lider.
+// Regresa el fd del lider o -1.
+static int perf_abrir(void)
+{
+    static const uint64_t eventos[NUM_CONTADORES] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int fds[NUM_CONTADORES];
+    for ( int i = 0; i < NUM_CONTADORES; ++i ) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = eventos[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i ? fds[0] : -1, 0);
+        if ( fds[i] < 0 ) {
+            while ( i-- ) {
+                close(fds[i]);
+            }
+            return -1;
+        }
+    }
+    return fds[0];
+}
+
+static int perf_leer(int fd, uint64_t* valores)
+{
+    struct {
+        uint64_t num;
+        uint64_t valores[NUM_CONTADORES];
+    } grupo;
+    if ( read(fd, &grupo, sizeof(grupo)) != (ssize_t)sizeof(grupo) || grupo.num != NUM_CONTADORES ) {
+        return 0;
+    }
+    memcpy(valores, grupo.valores, sizeof(grupo.valores));
+    return 1;
+}
+
+#else  // Sin contadores en otras plataformas.
+
+static int perf_abrir(void)
+{
+    return -1;
+}
+
+static int perf_leer(int fd, uint64_t* valores)
+{
+    return 0;
+}
 
-                // Enseña las transiciones del automata, pero ya estan en el
-                // .csv asi que no vale la pena descomentarlo.
-#if 0
-                for (int qi = 0; qi < MAX_NUM_ESTADOS; ++qi) {
-                    if (g_finales[qi] >= 0) {
-                        for (int ai = 0; ai < sb_count(alfabeto); ++ai) {
-                            char a = alfabeto[ai];
-                            sgl_log("d(%d, %c) = %d (F=%d)\n",
-                                    qi, a,
-                                    g_AF[qi][a],
-                                    g_finales[qi]);
-                        }
-                    }
-                }
 #endif
 
-                // Marcar alcanzables
-                int* alcanzables = NULL;
-                sb_push(alcanzables, 1);  // El estado inicial es alcanzable
-                int fijo = 0;
-                while ( !fijo ) {
-                    fijo = 1;
-                    for (int qi = 0; qi < sb_count(alcanzables); ++qi) {
-                        int q = alcanzables[qi];
-                        for (int ai = 0; ai < sb_count(alfabeto); ++ai) {
-                            char a = alfabeto[ai];
-                            int p = g_AF[q][a];
-                            if ( g_AF[q][a] != -1 && !sb_find(alcanzables, p)) {
-                                // Encontramos un nuevo estado alcanzable.
-                                sb_push(alcanzables, p);
-                                fijo = 0;
-                            }
-                        }
-                    }
-                }
-                sgl_log("Alcanzables: ");
-                for (int qi = 0; qi < sb_count(alcanzables); ++qi) {
-                    int q = alcanzables[qi];
-                    sgl_log("%d", q);
-                    if (qi == sb_count(alcanzables) - 1) {
-                        sgl_log("\n");
-                    } else {
-                        sgl_log(", ");
-                    }
-                }
+static char* g_nombres_etapas[NUM_ETAPAS] = { "lectura", "alcanzables", "punto fijo", "clases", "salida" };
+
+static void medir_inicio(int etapa)
+{
+    if ( g_medicion.traza ) {
+        sgl_trace_begin(g_nombres_etapas[etapa]);
+    }
+    if ( !g_medicion.perf ) {
+        return;
+    }
+    if ( g_perf_fd == 0 ) {
+        int fd = perf_abrir();
+        g_perf_fd = fd >= 0 ? fd + 1 : -1;
+    }
+    uint64_t* inicio = g_inicio_etapa[etapa];
+    if ( g_perf_fd < 0 || !perf_leer(g_perf_fd - 1, inicio + 1) ) {
+        memset(inicio + 1, 0, NUM_CONTADORES * sizeof(uint64_t));
+    }
+    inicio[0] = (uint64_t)sgl_get_time_us();
+}
 
-                // Tabla inicialmente en zeros, de estados distinguibles
-                int* distinguibles = (int*) sgl_calloc(MAX_NUM_ESTADOS * MAX_NUM_ESTADOS, sizeof(int));
+static void medir_fin(int etapa)
+{
+    if ( g_medicion.perf ) {
+        uint64_t fin[1 + NUM_CONTADORES] = { 0 };
+        fin[0] = (uint64_t)sgl_get_time_us();
+        int con_contadores = g_perf_fd > 0 && perf_leer(g_perf_fd - 1, fin + 1);
+        sgl_mutex_lock(g_medicion.mutex);
+        g_medicion.veces[etapa]++;
+        g_medicion.contadores |= con_contadores;
+        for ( int i = 0; i < 1 + NUM_CONTADORES; ++i ) {
+            if ( i == 0 || con_contadores ) {
+                g_medicion.total[etapa][i] += fin[i] - g_inicio_etapa[etapa][i];
+            }
+        }
+        sgl_mutex_unlock(g_medicion.mutex);
+    }
+    if ( g_medicion.traza ) {
+        sgl_trace_end();
+    }
+}
 
-                int ac = sb_count(alcanzables);
+static void imprimir_medicion(void)
+{
+    sgl_log("\n    ==== Medicion por etapa ====\n");
+    sgl_log("%-12s %6s %12s", "etapa", "veces", "tiempo (us)");
+    if ( g_medicion.contadores ) {
+        sgl_log(" %14s %14s %14s %14s", "ciclos", "instrucciones", "fallos cache", "fallos salto");
+    }
+    sgl_log("\n");
+    for ( int e = 0; e < NUM_ETAPAS; ++e ) {
+        uint64_t* t = g_medicion.total[e];
+        sgl_log("%-12s %6" PRId64 " %12" PRIu64, g_nombres_etapas[e], g_medicion.veces[e], t[0]);
+        if ( g_medicion.contadores ) {
+            sgl_log(" %14" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64, t[1], t[2], t[3], t[4]);
+        }
+        sgl_log("\n");
+    }
+    if ( !g_medicion.contadores ) {
+        sgl_log("(No se pudieron abrir los contadores del procesador; solo hay tiempos.)\n");
+    }
+}
 
-                // Marcar finales y no finales como distinguibles.
-                for ( int pi = 0; pi < ac; ++pi ) {
-                    for ( int qi = pi + 1; qi < ac; ++qi ) {
-                        int p = alcanzables[pi];
-                        int q = alcanzables[qi];
-                        if ( g_finales[p] != g_finales[q] ) {
-                            marcar_distinguibles(distinguibles, p, q);
-                        }
-                    }
-                }
+// ==== Lectura
 
-                // Punto fijo: marcar (q,p) como distinguibles si d(p,a) y
-                // d(q,a) son distinguibles para a en el alfabeto
-
-                fijo = 0;
-                while (!fijo) {
-                    fijo = 1;
-                    for ( int pi = 0; pi < ac; ++pi ) {
-                        for ( int qi = pi + 1; qi < ac; ++qi ) {
-                            int p = alcanzables[pi];
-                            int q = alcanzables[qi];
-                            if ( !son_distinguibles(distinguibles, p, q) ) {
-                                for ( int ai = 0; ai < sb_count(alfabeto); ++ai ) {
-                                    char a = alfabeto[ai];
-                                    int pa = g_AF[p][a];
-                                    int qa = g_AF[q][a];
-                                    if ( son_distinguibles(distinguibles, pa, qa) ) {
-                                        fijo = 0;
-                                        marcar_distinguibles(distinguibles, p, q);
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+// Dejar el automata en valores invalidos, antes de cargar un archivo.
+static void af_iniciar(AF* af)
+{
+    memset(af->tabla, 0, sizeof(af->tabla));
+    memset(af->en_alfabeto, 0, sizeof(af->en_alfabeto));
+    memset(af->finales, -1, sizeof(af->finales));
+    if ( af->extras ) {
+        sgl__sbcount(af->extras) = 0;
+    }
+    if ( af->rangos ) {
+        sgl__sbcount(af->rangos) = 0;
+    }
+    af->estados_afn = 0;
+    af->num_intervalos = 0;
+    af->num_simbolos = 0;
+    af->num_estados = 2;
+}
 
-                // Imprimir informacion de estados equivalentes..
-                for ( int pi = 0; pi < ac; ++pi ) {
-                    for ( int qi = pi + 1; qi < ac; ++qi ) {
-                        int p = alcanzables[pi];
-                        int q = alcanzables[qi];
-                        if ( !son_distinguibles(distinguibles, p, q) ) {
-                            sgl_log("%d y %d son equivalentes\n", p, q);
-                        }
-                    }
-                }
+// ---- Rangos
+//
+// Una ENTRADA tambien puede ser un rango DESDE-HASTA, y los simbolos pueden
+// ser cualquier punto de codigo de Unicode, escrito como caracter UTF-8 o
+// como U+HHHH:  1, a-z,2, U+0080-U+10FFFF,3, é,4, 0
+// Las transiciones por rango se guardan aparte mientras se lee el archivo, y
+// al cerrarlo af_intervalos() parte los puntos de codigo en intervalos
+// elementales y les da una columna a cada uno. La tabla y los algoritmos
+// siguen igual: solo ven columnas. Los archivos que solo usan caracteres
+// ASCII sueltos se quedan con una columna por caracter, como antes.
 
-                // Crear clases.
-                int* clases[MAX_NUM_ESTADOS] = { 0 };
-                int num_clases = 0;
-
-                // La primera clase tiene al estado inicial.
-                int* nueva_clase = NULL;
-                sb_push(nueva_clase, 1);
-                clases[num_clases++] = nueva_clase;
-
-                // Iterar por estados. Crear nuevas clases o agregar estados
-                // equivalentes a las clases existentes.
-                fijo = 0;
-                while ( !fijo ) {
-                    fijo = 1;
-                    for ( int pi = 0; pi < ac; ++pi ) {
-                        int p = alcanzables[pi];
-                        int pertenece = 0;
-                        for ( int ci = 0; ci < num_clases; ++ci ) {
-                            if ( !sb_find(clases[ci], p) ) {
-                                // Si no esta en la clase...
-                                if ( !son_distinguibles(distinguibles, clases[ci][0], p) ) {
-                                    // ... pero pertenece, agregar.
-                                    pertenece = 1;
-                                    sb_push(clases[ci], p);
-                                    fijo = 0;
-                                }
-                            } else {
-                                pertenece = 1;
-                            }
-                        }
+#define UTF8_INVALIDO       0xFFFFFFFFu
+#define MAX_PUNTO_CODIGO    0x10FFFF
 
-                        if ( !pertenece ) {  // No pertence a alguna clase. Crear una nueva.
-                            int* nc = NULL;
-                            sb_push(nc, p);
-                            clases[num_clases++] = nc;
-                            fijo = 0;
-                        }
-                    }
-                }
+// Decodifica el siguiente caracter UTF-8 entre *s y fin, y avanza. Una
+// secuencia invalida regresa UTF8_INVALIDO y avanza un byte.
+static uint32_t utf8_siguiente(const char** s, const char* fin)
+{
+    static const uint32_t minimo[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    const uint8_t* p = (const uint8_t*)*s;
+    uint32_t cp = p[0];
+    int largo = cp < 0x80 ? 1 : (cp >> 5) == 0x6 ? 2 : (cp >> 4) == 0xe ? 3 : (cp >> 3) == 0x1e ? 4 : 0;
+    *s += 1;
+    if ( largo == 1 ) {
+        return cp;
+    }
+    if ( largo == 0 || fin - (const char*)p < largo ) {
+        return UTF8_INVALIDO;
+    }
+    cp &= 0x7f >> largo;
+    for ( int i = 1; i < largo; ++i ) {
+        if ( (p[i] & 0xc0) != 0x80 ) {
+            return UTF8_INVALIDO;
+        }
+        cp = (cp << 6) | (p[i] & 0x3f);
+    }
+    if ( cp < minimo[largo] || cp > MAX_PUNTO_CODIGO || (cp >= 0xd800 && cp <= 0xdfff) ) {
+        return UTF8_INVALIDO;
+    }
+    *s += largo - 1;
+    return cp;
+}
 
-                // Para hacer las cosas mas legibles, encontrar la clase que tiene el estado error...
-                int clase_error = -1;
-                for ( int ci = 0; ci < num_clases; ++ci ) {
-                    if ( sb_find(clases[ci], 0) ) {
-                        clase_error = ci;
-                        break;
-                    }
-                }
+// Un simbolo del csv: U+HHHH o un caracter UTF-8.
+static int leer_simbolo(const char** s, const char* fin, uint32_t* cp)
+{
+    const char* p = *s;
+    if ( fin - p > 2 && p[0] == 'U' && p[1] == '+' && isxdigit((unsigned char)p[2]) ) {
+        char* final;
+        unsigned long v = strtoul(p + 2, &final, 16);
+        if ( v > MAX_PUNTO_CODIGO ) {
+            return 0;
+        }
+        *cp = (uint32_t)v;
+        *s = final;
+        return 1;
+    }
+    if ( p >= fin ) {
+        return 0;
+    }
+    *cp = utf8_siguiente(s, fin);
+    return *cp != UTF8_INVALIDO;
+}
+
+// Una ENTRADA con rangos: SIMBOLO o SIMBOLO-SIMBOLO. Regresa 0 si tok no es
+// ninguno de los dos.
+static int leer_rango(const char* tok, uint32_t* desde, uint32_t* hasta)
+{
+    const char* fin = tok + strlen(tok);
+    if ( !leer_simbolo(&tok, fin, desde) ) {
+        return 0;
+    }
+    *hasta = *desde;
+    if ( tok < fin && *tok == '-' ) {
+        ++tok;
+        if ( !leer_simbolo(&tok, fin, hasta) ) {
+            return 0;
+        }
+    }
+    return tok == fin;
+}
+
+// La columna del intervalo que tiene a cp, o -1 si cp no esta en el alfabeto.
+static int af_columna(AF* af, uint32_t cp)
+{
+    if ( !af->num_intervalos ) {
+        return (cp < NUM_ASCII_CHARS && af->en_alfabeto[cp]) ? (int)cp : -1;
+    }
+    int izq = 0;
+    int der = af->num_intervalos;
+    while ( der - izq > 1 ) {
+        int medio = (izq + der) / 2;
+        if ( af->desde[medio] <= cp ) {
+            izq = medio;
+        } else {
+            der = medio;
+        }
+    }
+    return (af->desde[izq] <= cp && cp <= af->hasta[izq]) ? izq : -1;
+}
 
-                // Imprimir el nuevo autómata.
+// La columna del siguiente simbolo de una cadena, y avanza. Sin rangos, los
+// simbolos son bytes; con rangos, caracteres UTF-8.
+static int af_siguiente_columna(AF* af, const char** s, const char* fin)
+{
+    if ( !af->num_intervalos ) {
+        uint8_t c = (uint8_t)**s;
+        *s += 1;
+        return af_columna(af, c);
+    }
+    uint32_t cp = utf8_siguiente(s, fin);
+    return cp == UTF8_INVALIDO ? -1 : af_columna(af, cp);
+}
 
-                sgl_log ("    ==== El automata minimizado (el estado inicial es q0) ====\n");
+// Escribe un intervalo como se escribe en el csv, para que la salida se pueda
+// volver a leer. `texto` tiene que tener lugar para TAM_TEXTO_INTERVALO bytes.
+#define TAM_TEXTO_INTERVALO 32
 
-                for ( int ci = 0; ci < num_clases; ++ci ) {
-                    if ( ci == clase_error ) {
-                        continue;
-                    }
-                    int* clase = clases[ci];
-                    int p = clase[0];  // Solo nos interesa un elemento, para ver a donde va.
-                    for ( int ai = 0; ai < sb_count(alfabeto); ++ai ) {
-                        char a = alfabeto[ai];
-                        int q = g_AF[p][a];
-                        // Encontrar la clase de q;
-                        int transicion = -1;
-                        for ( int cii = 0; cii < num_clases; ++cii ) {
-                            if ( sb_find(clases[cii], q) ) {
-                                transicion = cii;
-                                break;
-                            }
-                        }
-                        // Imprimir.
-                        if ( transicion != clase_error ) {
-                            sgl_log("d(q%d, %c) = q%d\n", ci, a, transicion);
-                        } else {
-                            sgl_log("d(q%d, %c) = E\n", ci, a);
-                        }
-                    }
-                }
-                // Imprimir las transiciones del estado error.
-                for ( int ai = 0; ai < sb_count(alfabeto); ++ai ) {
-                    sgl_log("d(E, %c) = E\n", alfabeto[ai]);
-                }
+static char* texto_punto(char* texto, uint32_t cp, int solo)
+{
+    // Sin controles, espacios, uso privado ni planos sin asignar.
+    int visible = ((cp > 0x20 && cp < 0x7f && cp != ',') ||
+                   (cp > 0xa0 && cp < 0x30000 && !(cp >= 0xd800 && cp < 0xf900) && !(cp >= 0xfff0 && cp < 0x10000))) &&
+                  !(solo && ((cp >= '0' && cp <= '9') || cp == '-'));
+    if ( !visible ) {
+        return texto + sprintf(texto, "U+%04" PRIX32, cp);
+    }
+    if ( cp < 0x80 ) {
+        *texto++ = (char)cp;
+    } else if ( cp < 0x800 ) {
+        *texto++ = (char)(0xc0 | (cp >> 6));
+        *texto++ = (char)(0x80 | (cp & 0x3f));
+    } else if ( cp < 0x10000 ) {
+        *texto++ = (char)(0xe0 | (cp >> 12));
+        *texto++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+        *texto++ = (char)(0x80 | (cp & 0x3f));
+    } else {
+        *texto++ = (char)(0xf0 | (cp >> 18));
+        *texto++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+        *texto++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+        *texto++ = (char)(0x80 | (cp & 0x3f));
+    }
+    *texto = '\0';
+    return texto;
+}
 
-                // Indicar los estados finales.
-                sgl_log("Estados finales: [ ");
-                for ( int ci = 0; ci < num_clases; ++ci ) {
-                    int p = clases[ci][0];
-                    if ( g_finales[p] ) {
-                        sgl_log("q%d ", ci);
-                    }
-                }
-                sgl_log("]\n");
+static char* texto_intervalo(char* texto, uint32_t desde, uint32_t hasta)
+{
+    char* fin = texto_punto(texto, desde, desde == hasta);
+    if ( hasta != desde ) {
+        *fin++ = '-';
+        texto_punto(fin, hasta, 0);
+    }
+    return texto;
+}
+
+// El nombre de la columna a: el caracter, o su intervalo si hay rangos.
+static char* texto_simbolo(char* texto, AF* af, int a)
+{
+    if ( !af->num_intervalos ) {
+        texto[0] = (char)a;
+        texto[1] = '\0';
+        return texto;
+    }
+    return texto_intervalo(texto, af->desde[a], af->hasta[a]);
+}
+
+static int comparar_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// El indice de la ultima frontera <= cp.
+static int buscar_frontera(uint32_t* fronteras, int n, uint32_t cp)
+{
+    int izq = 0;
+    int der = n;
+    while ( der - izq > 1 ) {
+        int medio = (izq + der) / 2;
+        if ( fronteras[medio] <= cp ) {
+            izq = medio;
+        } else {
+            der = medio;
+        }
+    }
+    return izq;
+}
+
+// Convierte los rangos (y los caracteres sueltos) en columnas. Los extremos de
+// todos los rangos parten los puntos de codigo en intervalos elementales:
+// dentro de uno, todos los simbolos van a los mismos estados, asi que cada
+// intervalo cubierto por alguna transicion es una columna. Despues se juntan
+// los intervalos vecinos cuyas columnas quedaron iguales en todos los
+// estados, para que partir un rango en un estado no deje la tabla partida
+// en los demas. El numero de columnas depende de cuantos rangos distintos hay
+// y no de cuantos simbolos cubren.
+static void af_intervalos(AF* af, Arena* temp)
+{
+    int n = af->num_estados;
+    int nr = sb_count(af->rangos);
+    int ne = sb_count(af->extras);
+
+    // Cada rango y cada caracter suelto agregan a lo mas dos fronteras.
+    int max_fronteras = 2 * (nr + NUM_ASCII_CHARS) + 1;
+    Arena hijo = arena_push(temp, arena_available_space(temp));
+    uint32_t* fronteras = arena_alloc_array(&hijo, max_fronteras, uint32_t);
+    int* cubierto = arena_alloc_array(&hijo, max_fronteras, int);
+    int* columna = arena_alloc_array(&hijo, max_fronteras, int);  // Intervalo elemental -> columna cruda.
+    if ( !fronteras || !cubierto || !columna ) {
+        panico("El automata tiene demasiados rangos.");
+    }
+
+    int nf = 0;
+    for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+        if ( af->en_alfabeto[c] ) {
+            fronteras[nf++] = (uint32_t)c;
+            fronteras[nf++] = (uint32_t)c + 1;
+        }
+    }
+    for ( int i = 0; i < nr; ++i ) {
+        fronteras[nf++] = af->rangos[i].desde;
+        fronteras[nf++] = af->rangos[i].hasta + 1;
+    }
+    qsort(fronteras, nf, sizeof(uint32_t), comparar_u32);
+    int unicas = 0;
+    for ( int i = 0; i < nf; ++i ) {
+        if ( unicas == 0 || fronteras[unicas - 1] != fronteras[i] ) {
+            fronteras[unicas++] = fronteras[i];
+        }
+    }
+    nf = unicas;
+
+    // Que intervalos elementales cubre alguna transicion: +1 donde empieza un
+    // rango y -1 donde termina, y luego sumas acumuladas.
+    for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+        if ( af->en_alfabeto[c] ) {
+            int f = buscar_frontera(fronteras, nf, (uint32_t)c);
+            cubierto[f]++;
+            cubierto[f + 1]--;
+        }
+    }
+    for ( int i = 0; i < nr; ++i ) {
+        cubierto[buscar_frontera(fronteras, nf, af->rangos[i].desde)]++;
+        cubierto[buscar_frontera(fronteras, nf, af->rangos[i].hasta + 1)]--;
+    }
+    int nc = 0;
+    for ( int f = 0, suma = 0; f < nf; ++f ) {
+        suma += cubierto[f];
+        columna[f] = suma > 0 ? nc++ : -1;
+    }
+
+    int* crudo = arena_alloc_array(&hijo, (size_t)n * nc, int);  // crudo[q * nc + columna]
+    uint8_t* con_extras = arena_alloc_array(&hijo, nc, uint8_t);
+    int* grupo = arena_alloc_array(&hijo, nc, int);                // Columna cruda -> columna final.
+    if ( !crudo || !con_extras || !grupo ) {
+        panico("El automata tiene demasiados rangos.");
+    }
+    for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+        if ( af->en_alfabeto[c] ) {
+            int k = columna[buscar_frontera(fronteras, nf, (uint32_t)c)];
+            for ( int q = 0; q < n; ++q ) {
+                crudo[q * nc + k] = af->tabla[q][c];
+            }
+        }
+    }
+    for ( int i = 0; i < ne; ++i ) {
+        Transicion* t = &af->extras[i];
+        if ( t->entrada != EPSILON ) {
+            t->entrada = columna[buscar_frontera(fronteras, nf, (uint32_t)t->entrada)];
+            con_extras[t->entrada] = 1;
+        }
+    }
+    for ( int i = 0; i < nr; ++i ) {
+        Rango* r = &af->rangos[i];
+        if ( !r->destino ) {
+            continue;
+        }
+        int f = buscar_frontera(fronteras, nf, r->desde);
+        for ( ; f < nf && fronteras[f] <= r->hasta; ++f ) {
+            int k = columna[f];
+            int* d = &crudo[r->estado * nc + k];
+            if ( *d && *d != r->destino ) {
+                // Se traslapa con otra transicion del mismo estado: es un AFN.
+                Transicion t = { r->estado, k, r->destino };
+                sb_push(af->extras, t);
+                con_extras[k] = 1;
+            } else {
+                *d = r->destino;
+            }
+        }
+    }
+
+    // Juntar columnas vecinas iguales.
+    memset(af->tabla, 0, sizeof(af->tabla));
+    memset(af->en_alfabeto, 0, sizeof(af->en_alfabeto));
+    int num_columnas = 0;
+    for ( int f = 0; f < nf; ++f ) {
+        int k = columna[f];
+        if ( k < 0 ) {
+            continue;
+        }
+        uint32_t hasta = f + 1 < nf ? fronteras[f + 1] - 1 : MAX_PUNTO_CODIGO;
+        int g = num_columnas - 1;
+        int juntar = g >= 0 && af->hasta[g] + 1 == fronteras[f] && !con_extras[k] && !con_extras[k - 1];
+        for ( int q = 0; q < n && juntar; ++q ) {
+            juntar = crudo[q * nc + k] == crudo[q * nc + k - 1];
+        }
+        if ( juntar ) {
+            af->hasta[g] = hasta;
+        } else {
+            if ( num_columnas >= MAX_COLUMNAS ) {
+                panico("El automata tiene demasiados intervalos distintos en el alfabeto.");
+            }
+            g = num_columnas++;
+            af->desde[g] = fronteras[f];
+            af->hasta[g] = hasta;
+            af->en_alfabeto[g] = 1;
+            for ( int q = 0; q < n; ++q ) {
+                af->tabla[q][g] = (estado_t)crudo[q * nc + k];
             }
         }
+        grupo[k] = g;
+    }
+    for ( int i = 0; i < sb_count(af->extras); ++i ) {
+        Transicion* t = &af->extras[i];
+        if ( t->entrada != EPSILON ) {
+            t->entrada = grupo[t->entrada];
+        }
+    }
+    af->num_intervalos = num_columnas;
+    arena_pop(&hijo);
+}
+
+// Interpreta una linea (que no es comentario) del archivo y llena la tabla.
+// La linea se modifica en su lugar. Regresa 1 si la linea tenia datos.
+static int interpretar_linea(AF* af, char* linea, int es_primera)
+{
+    int parse_state = PARSE_estado;
+    int estado = -1;
+    int entrada_actual = 0;
+    uint32_t desde = 0;
+    uint32_t hasta = 0;
+    int con_datos = 0;
+    char* iter = linea;
+    char* tok;
+    while ( (tok = sgl_tokenize_inplace(&iter, ',')) != NULL ) {
+        tok = sgl_strip_whitespace_inplace(tok);
+        con_datos = 1;
+
+        switch (parse_state) {
+        case PARSE_estado: {
+                if (!sgl_is_number(tok)) {
+                    panico("El estado no se define correctamente.");
+                }
+                estado = atoi(tok);
+                if ( estado <= 0 || estado >= MAX_NUM_ESTADOS ) {
+                    panico("Estado invalido\n");
+                }
+                if (es_primera && estado != 1) {
+                    panico("El primer estado tiene que ser 1");
+                }
+                af->num_estados = max(af->num_estados, estado + 1);
+                parse_state = PARSE_entrada;
+                break;
+            }
+        case PARSE_entrada: {
+            if ( sgl_is_number(tok) ) {
+                // Al recibir un numbero en lugar de una letra, asumimos que es final
+                int final = atoi(tok);
+                if (final == 0 || final == 1 ) {
+                    af->finales[estado] = final;
+                    parse_state = PARSE_final;
+                } else {
+                    panico("Definicion de final tiene que ser 0 o 1.");
+                }
+            } else if (strlen(tok) == 1 && (unsigned char)tok[0] < NUM_ASCII_CHARS){
+                entrada_actual = (unsigned char)tok[0];
+                af->en_alfabeto[entrada_actual] = 1;  // Marcar este caracter como "en el alfabeto"
+                parse_state = PARSE_trans;
+            } else if ( strcmp(tok, "eps") == 0 ) {
+                entrada_actual = EPSILON;
+                parse_state = PARSE_trans;
+            } else if ( leer_rango(tok, &desde, &hasta) ) {
+                if ( desde > hasta ) {
+                    panico("El rango esta al reves.");
+                }
+                if ( desde == hasta && desde < NUM_ASCII_CHARS ) {
+                    af->en_alfabeto[desde] = 1;
+                    entrada_actual = (int)desde;
+                } else {
+                    entrada_actual = ENTRADA_RANGO;
+                }
+                parse_state = PARSE_trans;
+            } else {
+                panico("entrada no bien definida (debe ser un caracter no numerico o un rango)");
+            }
+            break;
+        }
+        case PARSE_trans: {
+            if ( !sgl_is_number(tok) ) {
+                panico("Las transiciones deben ser numeros positivos (estados).");
+            } else {
+                int e = atoi(tok);
+                if ( e >= MAX_NUM_ESTADOS ) {
+                    panico("Estado invalido\n");
+                }
+                if ( entrada_actual == ENTRADA_RANGO ) {
+                    Rango r = { estado, desde, hasta, e > 0 ? e : 0 };
+                    sb_push(af->rangos, r);
+                    af->num_estados = max(af->num_estados, e + 1);
+                } else if (e > 0) {
+                    if ( entrada_actual == EPSILON ||
+                         (af->tabla[estado][entrada_actual] && af->tabla[estado][entrada_actual] != e) ) {
+                        Transicion t = { estado, entrada_actual, e };
+                        sb_push(af->extras, t);
+                    } else {
+                        af->tabla[estado][entrada_actual] = e;
+                    }
+                    af->num_estados = max(af->num_estados, e + 1);
+                }
+                parse_state = PARSE_entrada;
+            }
+            break;
+        }
+        case PARSE_final: {
+            panico("Mas datos en el archivo de los esperados");
+            break;
+        }
+        }
+    }
+    return con_datos;
+}
+
+// ==== Determinizacion
+//
+// Construccion de subconjuntos. Los conjuntos de estados del AFN son bitsets
+// de CONJ_PALABRAS palabras, y cada conjunto nuevo se busca en una tabla hash
+// con direccionamiento abierto. Todo se aparta de una arena temporal, que se
+// libera completa al terminar.
+
+#define CONJ_PALABRAS ((MAX_NUM_ESTADOS + 63) / 64)
+
+typedef struct Conjunto_s {
+    uint64_t w[CONJ_PALABRAS];
+} Conjunto;
+
+static void conj_agregar(Conjunto* c, int q)
+{
+    c->w[q / 64] |= (uint64_t)1 << (q % 64);
+}
+
+static int conj_tiene(Conjunto* c, int q)
+{
+    return (c->w[q / 64] >> (q % 64)) & 1;
+}
+
+static void conj_quitar(Conjunto* c, int q)
+{
+    c->w[q / 64] &= ~((uint64_t)1 << (q % 64));
+}
+
+static void conj_unir(Conjunto* c, Conjunto* otro)
+{
+    for ( int i = 0; i < CONJ_PALABRAS; ++i ) {
+        c->w[i] |= otro->w[i];
+    }
+}
+
+static int conj_vacio(Conjunto* c)
+{
+    for ( int i = 0; i < CONJ_PALABRAS; ++i ) {
+        if ( c->w[i] ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint64_t conj_hash(Conjunto* c)
+{
+    return fnv(FNV_BASE, c->w, sizeof(c->w));
+}
+
+// Cerradura epsilon de cada estado, por punto fijo.
+static void clausuras_epsilon(AF* af, Conjunto* clausura)
+{
+    for ( int q = 0; q < af->num_estados; ++q ) {
+        conj_agregar(&clausura[q], q);
+    }
+    int fijo = 0;
+    while ( !fijo ) {
+        fijo = 1;
+        for ( int i = 0; i < sb_count(af->extras); ++i ) {
+            Transicion* t = &af->extras[i];
+            if ( t->entrada != EPSILON ) {
+                continue;
+            }
+            // Todo lo que alcanza t->estado alcanza lo que alcanza t->destino.
+            for ( int q = 0; q < af->num_estados; ++q ) {
+                if ( conj_tiene(&clausura[q], t->estado) ) {
+                    Conjunto antes = clausura[q];
+                    conj_unir(&clausura[q], &clausura[t->destino]);
+                    if ( memcmp(&antes, &clausura[q], sizeof(Conjunto)) != 0 ) {
+                        fijo = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Reemplaza el AFN (tabla + extras) por un AF equivalente. El estado 1 del AF
+// es la cerradura de {1} y el conjunto vacio es el estado error.
+static void determinizar(AF* af, Arena* temp)
+{
+    int n = af->num_estados;
+    int ns = af->num_simbolos;
+    size_t tam_tabla = 1;  // Potencia de 2, mas del doble de los estados del AF.
+    while ( tam_tabla < 2 * MAX_NUM_ESTADOS ) {
+        tam_tabla *= 2;
+    }
+    Arena hijo = arena_push(temp,
+                            (n + n * ns + MAX_NUM_ESTADOS + tam_tabla) * sizeof(Conjunto) +
+                            tam_tabla * sizeof(int));
+    Conjunto* clausura = arena_alloc_array(&hijo, n, Conjunto);
+    Conjunto* delta = arena_alloc_array(&hijo, n * ns, Conjunto);      // Ya con cerradura.
+    Conjunto* subconjuntos = arena_alloc_array(&hijo, MAX_NUM_ESTADOS, Conjunto);
+    Conjunto* llaves = arena_alloc_array(&hijo, tam_tabla, Conjunto);
+    int* valores = arena_alloc_array(&hijo, tam_tabla, int);            // 0 es un lugar vacio.
+
+    clausuras_epsilon(af, clausura);
+
+    int columna[MAX_COLUMNAS];
+    for ( int ai = 0; ai < ns; ++ai ) {
+        columna[af->alfabeto[ai]] = ai;
+    }
+    for ( int q = 0; q < n; ++q ) {
+        for ( int ai = 0; ai < ns; ++ai ) {
+            int p = af->tabla[q][af->alfabeto[ai]];
+            if ( p ) {
+                conj_unir(&delta[q * ns + ai], &clausura[p]);
+            }
+        }
+    }
+    for ( int i = 0; i < sb_count(af->extras); ++i ) {
+        Transicion* t = &af->extras[i];
+        if ( t->entrada != EPSILON ) {
+            conj_unir(&delta[t->estado * ns + columna[t->entrada]], &clausura[t->destino]);
+        }
+    }
+
+    int finales_afn[MAX_NUM_ESTADOS];
+    memcpy(finales_afn, af->finales, sizeof(finales_afn));
+
+    int num_subconjuntos = 1;  // El 0 es el conjunto vacio.
+    subconjuntos[num_subconjuntos++] = clausura[1];
+    {
+        uint64_t h = conj_hash(&clausura[1]) & (tam_tabla - 1);
+        llaves[h] = clausura[1];
+        valores[h] = 1;
+    }
+
+    memset(af->tabla, 0, sizeof(af->tabla));
+    memset(af->finales, 0, sizeof(af->finales));
+    for ( int d = 1; d < num_subconjuntos; ++d ) {
+        Conjunto* S = &subconjuntos[d];
+        for ( int i = 0; i < CONJ_PALABRAS; ++i ) {
+            for ( uint64_t bits = S->w[i]; bits; bits &= bits - 1 ) {
+                if ( finales_afn[64 * i + bit_menor(bits)] > 0 ) {
+                    af->finales[d] = 1;
+                }
+            }
+        }
+        for ( int ai = 0; ai < ns; ++ai ) {
+            Conjunto T = { 0 };
+            for ( int i = 0; i < CONJ_PALABRAS; ++i ) {
+                for ( uint64_t bits = S->w[i]; bits; bits &= bits - 1 ) {
+                    conj_unir(&T, &delta[(64 * i + bit_menor(bits)) * ns + ai]);
+                }
+            }
+            if ( conj_vacio(&T) ) {
+                continue;  // Estado error
+            }
+            uint64_t h = conj_hash(&T) & (tam_tabla - 1);
+            while ( valores[h] && memcmp(&llaves[h], &T, sizeof(Conjunto)) != 0 ) {
+                h = (h + 1) & (tam_tabla - 1);
+            }
+            if ( !valores[h] ) {
+                if ( num_subconjuntos >= MAX_NUM_ESTADOS ) {
+                    panico("El automata determinista tiene demasiados estados.");
+                }
+                llaves[h] = T;
+                valores[h] = num_subconjuntos;
+                subconjuntos[num_subconjuntos++] = T;
+            }
+            af->tabla[d][af->alfabeto[ai]] = valores[h];
+        }
+    }
+    arena_pop(&hijo);
+
+    af->estados_afn = n - 1;
+    af->num_estados = num_subconjuntos;
+    sgl__sbcount(af->extras) = 0;
+}
+
+// Terminar de construir el automata despues de interpretar todas las lineas.
+static void af_cerrar(AF* af, Arena* temp)
+{
+    // Marcar estado error como no-final. Los estados que se mencionan pero no
+    // se definen se comportan igual que el estado error.
+    for ( int q = 0; q < af->num_estados; ++q ) {
+        if ( af->finales[q] < 0 ) {
+            af->finales[q] = 0;
+        }
+    }
+
+    if ( sb_count(af->rangos) ) {
+        af_intervalos(af, temp);
+    }
+
+    // Llenar el alfabeto de esta máquina:
+    af->num_simbolos = 0;
+    for(int ai = 0; ai < MAX_COLUMNAS; ++ai) {
+        if (af->en_alfabeto[ai] == 1) {
+            af->alfabeto[af->num_simbolos++] = ai;
+        }
+    }
+
+    if ( sb_count(af->extras) ) {
+        determinizar(af, temp);
+    }
+}
+
+// Lee un archivo csv y llena el automata. Regresa 0 si no se pudo abrir el
+// archivo.
+//
+// El archivo se lee por una ventana de tamaño fijo y cada linea se interpreta
+// en su lugar conforme llega, asi que la memoria para cargar depende solo del
+// automata y no del tamaño del archivo.
+#define TAM_VENTANA 4096
+
+static int cargar_af(AF* af, char* path, Arena* temp)
+{
+    char ventana[TAM_VENTANA];
+    SglLineReader lector;
+    if ( sgl_line_reader_open(&lector, path, ventana, TAM_VENTANA) != 0 ) {
+        return 0;
+    }
+    af_iniciar(af);
+    int es_primera = 1;
+    char* linea;
+    while ( (linea = sgl_line_reader_next(&lector)) != NULL ) {
+        if ( linea[0] == '#' ) {
+            // Es un comentario.
+            continue;
+        }
+        if ( interpretar_linea(af, linea, es_primera) ) {
+            es_primera = 0;
+        }
+    }
+    if ( lector.error ) {
+        panico("Hay una linea demasiado larga en el archivo.");
+    }
+    sgl_line_reader_close(&lector);
+    af_cerrar(af, temp);
+    return 1;
+}
+
+// Como cargar_af, pero el csv llega por pedazos de cualquier tamaño (del
+// pipeline o de una peticion al servidor). Cada linea se junta en `linea` y
+// se interpreta cuando llega su fin, asi que tampoco aqui la memoria depende
+// del tamaño del archivo.
+typedef struct LectorAF_s {
+    AF*     af;
+    int     es_primera;
+    int     largo;
+    char    linea[TAM_VENTANA];
+} LectorAF;
+
+static void lector_af_iniciar(LectorAF* l, AF* af)
+{
+    af_iniciar(af);
+    l->af = af;
+    l->es_primera = 1;
+    l->largo = 0;
+}
+
+static void lector_af_linea(LectorAF* l)
+{
+    l->linea[l->largo] = '\0';
+    if ( l->linea[0] != '#' && interpretar_linea(l->af, l->linea, l->es_primera) ) {
+        l->es_primera = 0;
+    }
+    l->largo = 0;
+}
+
+static void lector_af_agregar(LectorAF* l, const char* datos, size_t tam)
+{
+    for ( size_t i = 0; i < tam; ++i ) {
+        if ( datos[i] == '\n' ) {
+            lector_af_linea(l);
+        } else if ( l->largo < TAM_VENTANA - 1 ) {
+            l->linea[l->largo++] = datos[i];
+        } else {
+            panico("Hay una linea demasiado larga en el archivo.");
+        }
+    }
+}
+
+// Interpreta la ultima linea, aunque no tenga fin, y cierra el automata.
+static void lector_af_terminar(LectorAF* l, Arena* temp)
+{
+    if ( l->largo ) {
+        lector_af_linea(l);
+    }
+    af_cerrar(l->af, temp);
+}
+
+// ==== Expresiones regulares
+//
+// Construye el AFD directamente de una expresion regular con derivadas de
+// Brzozowski: el estado inicial es la expresion, y el estado al que se llega
+// con el simbolo a desde la expresion r es la derivada d_a(r), el lenguaje de
+// las cadenas w tales que aw esta en r. Un estado es final si su expresion
+// acepta la cadena vacia.
+//
+// Para que haya un numero finito de derivadas distintas, los terminos se
+// simplifican al construirlos (0 es el lenguaje vacio y 1 la cadena vacia):
+//      0r = r0 = 0,  1r = r1 = r,  (rs)t = r(st),  0* = 1* = 1,  r** = r*
+// y las alternativas se aplanan, se ordenan y se quitan repetidas, asi que
+// r|s, s|r y r|r|s son el mismo termino. Los terminos se guardan una sola vez
+// (hash-consing): construir un termino que ya existe regresa el mismo numero,
+// asi que comparar expresiones es comparar enteros.
+//
+// Sintaxis: | alternativa, * + ? repeticion, ( ) agrupar, [abc] y [a-z]
+// clases, \c un caracter literal. Los demas caracteres ascii son literales.
+// El alfabeto son los caracteres que aparecen en la expresion.
+
+#define MAX_TERMINOS (1 << 14)  // Cabe en TAM_ARENA_HILO.
+
+enum {
+    TERMINO_vacio,      // 0
+    TERMINO_epsilon,    // 1
+    TERMINO_caracter,
+    TERMINO_concat,
+    TERMINO_alt,
+    TERMINO_estrella
+};
+
+typedef struct Termino_s {
+    int     tipo;
+    int     a;          // Subterminos, o el caracter.
+    int     b;
+    int     anulable;   // Acepta la cadena vacia.
+} Termino;
+
+typedef struct Terminos_s {
+    Termino*    terminos;
+    int         num_terminos;
+    int*        tabla;      // Termino + 1, por hash. 0 es un lugar vacio.
+    const char* iter;       // Para el parser.
+    char        en_alfabeto[NUM_ASCII_CHARS];
+    Arena*      temp;       // Para las listas de re_alt que no caben en la pila.
+} Terminos;
+
+static int termino(Terminos* ts, int tipo, int a, int b, int anulable)
+{
+    Termino t = { tipo, a, b, anulable };
+    uint64_t h = fnv_entero(fnv_entero(fnv_entero(FNV_BASE, tipo), a), b);
+    size_t i = h & (2 * MAX_TERMINOS - 1);
+    while ( ts->tabla[i] ) {
+        Termino* otro = &ts->terminos[ts->tabla[i] - 1];
+        if ( otro->tipo == tipo && otro->a == a && otro->b == b ) {
+            return ts->tabla[i] - 1;
+        }
+        i = (i + 1) & (2 * MAX_TERMINOS - 1);
+    }
+    if ( ts->num_terminos == MAX_TERMINOS ) {
+        panico("La expresion regular genera demasiados terminos.");
+    }
+    ts->terminos[ts->num_terminos] = t;
+    ts->tabla[i] = ++ts->num_terminos;
+    return ts->num_terminos - 1;
+}
+
+// Los terminos 0 y 1 siempre son el vacio y epsilon.
+static int re_vacio(Terminos* ts)   { return termino(ts, TERMINO_vacio, 0, 0, 0); }
+static int re_epsilon(Terminos* ts) { return termino(ts, TERMINO_epsilon, 0, 0, 1); }
+
+static int re_caracter(Terminos* ts, char c)
+{
+    ts->en_alfabeto[(unsigned char)c] = 1;
+    return termino(ts, TERMINO_caracter, c, 0, 0);
+}
+
+static int re_concat(Terminos* ts, int r, int s)
+{
+    Termino* tr = &ts->terminos[r];
+    if ( tr->tipo == TERMINO_vacio || ts->terminos[s].tipo == TERMINO_vacio ) {
+        return re_vacio(ts);
+    }
+    if ( tr->tipo == TERMINO_epsilon ) {
+        return s;
+    }
+    if ( ts->terminos[s].tipo == TERMINO_epsilon ) {
+        return r;
+    }
+    if ( tr->tipo == TERMINO_concat ) {
+        int a = tr->a;
+        return re_concat(ts, a, re_concat(ts, tr->b, s));
+    }
+    return termino(ts, TERMINO_concat, r, s, tr->anulable && ts->terminos[s].anulable);
+}
+
+// Junta las alternativas de r en `lista`, sin los vacios.
+static int re_alternativas(Terminos* ts, int r, int* lista, int n)
+{
+    while ( ts->terminos[r].tipo == TERMINO_alt ) {
+        lista[n++] = ts->terminos[r].a;
+        r = ts->terminos[r].b;
+    }
+    if ( ts->terminos[r].tipo != TERMINO_vacio ) {
+        lista[n++] = r;
+    }
+    return n;
+}
+
+static int comparar_enteros(const void* a, const void* b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+static int re_alt(Terminos* ts, int r, int s)
+{
+    if ( r == s ) {
+        return r;
+    }
+    int largo = 2;
+    for ( int x = r; ts->terminos[x].tipo == TERMINO_alt; x = ts->terminos[x].b ) {
+        ++largo;
+    }
+    for ( int x = s; ts->terminos[x].tipo == TERMINO_alt; x = ts->terminos[x].b ) {
+        ++largo;
+    }
+    int lista_local[64];
+    int* lista = lista_local;
+    Arena hijo = { 0 };
+    if ( largo > 64 ) {
+        if ( largo * sizeof(int) > arena_available_space(ts->temp) ) {
+            panico("No hay memoria para la expresion regular");
+        }
+        hijo = arena_push(ts->temp, largo * sizeof(int));
+        lista = arena_alloc_array(&hijo, largo, int);
+    }
+    int n = re_alternativas(ts, r, lista, 0);
+    n = re_alternativas(ts, s, lista, n);
+    qsort(lista, n, sizeof(int), comparar_enteros);
+    int unicos = 0;
+    for ( int i = 0; i < n; ++i ) {
+        if ( !unicos || lista[unicos - 1] != lista[i] ) {
+            lista[unicos++] = lista[i];
+        }
+    }
+    int res = unicos ? lista[unicos - 1] : re_vacio(ts);
+    for ( int i = unicos - 2; i >= 0; --i ) {
+        int anulable = ts->terminos[lista[i]].anulable || ts->terminos[res].anulable;
+        res = termino(ts, TERMINO_alt, lista[i], res, anulable);
+    }
+    if ( lista != lista_local ) {
+        arena_pop(&hijo);
+    }
+    return res;
+}
+
+static int re_estrella(Terminos* ts, int r)
+{
+    int tipo = ts->terminos[r].tipo;
+    if ( tipo == TERMINO_vacio || tipo == TERMINO_epsilon ) {
+        return re_epsilon(ts);
+    }
+    if ( tipo == TERMINO_estrella ) {
+        return r;
+    }
+    return termino(ts, TERMINO_estrella, r, 0, 1);
+}
+
+static int re_derivada(Terminos* ts, int r, char c)
+{
+    Termino t = ts->terminos[r];  // Copia: `terminos` no se mueve, pero se llena.
+    switch ( t.tipo ) {
+    case TERMINO_caracter: {
+        return t.a == c ? re_epsilon(ts) : re_vacio(ts);
+    }
+    case TERMINO_concat: {
+        int d = re_concat(ts, re_derivada(ts, t.a, c), t.b);
+        return ts->terminos[t.a].anulable ? re_alt(ts, d, re_derivada(ts, t.b, c)) : d;
+    }
+    case TERMINO_alt: {
+        return re_alt(ts, re_derivada(ts, t.a, c), re_derivada(ts, t.b, c));
+    }
+    case TERMINO_estrella: {
+        return re_concat(ts, re_derivada(ts, t.a, c), r);
+    }
+    default: {
+        return re_vacio(ts);
+    }
+    }
+}
+
+// -- Parser, descenso recursivo.
+
+static int re_parse_alt(Terminos* ts);
+
+static char re_literal(Terminos* ts)
+{
+    char c = *ts->iter++;
+    if ( c == '\\' ) {
+        c = *ts->iter++;
+    }
+    if ( c == '\0' || (unsigned char)c >= NUM_ASCII_CHARS ) {
+        panico("Caracter invalido en la expresion regular.");
+    }
+    return c;
+}
+
+static int re_parse_atomo(Terminos* ts)
+{
+    char c = *ts->iter;
+    if ( c == '(' ) {
+        ts->iter++;
+        int r = re_parse_alt(ts);
+        if ( *ts->iter++ != ')' ) {
+            panico("Falta ')' en la expresion regular.");
+        }
+        return r;
+    }
+    if ( c == '[' ) {
+        ts->iter++;
+        int r = re_vacio(ts);
+        while ( *ts->iter != ']' ) {
+            char desde = re_literal(ts);
+            char hasta = desde;
+            if ( ts->iter[0] == '-' && ts->iter[1] != ']' ) {
+                ts->iter++;
+                hasta = re_literal(ts);
+                if ( hasta < desde ) {
+                    panico("Rango invalido en la expresion regular (el final va antes del inicio).");
+                }
+            }
+            for ( int x = desde; x <= hasta; ++x ) {
+                r = re_alt(ts, r, re_caracter(ts, (char)x));
+            }
+        }
+        ts->iter++;
+        return r;
+    }
+    if ( c == '*' || c == '+' || c == '?' || c == ')' || c == ']' ) {
+        panico("Operador fuera de lugar en la expresion regular.");
+    }
+    return re_caracter(ts, re_literal(ts));
+}
+
+static int re_parse_repeticion(Terminos* ts)
+{
+    int r = re_parse_atomo(ts);
+    for (;;) {
+        char c = *ts->iter;
+        if ( c == '*' ) {
+            r = re_estrella(ts, r);
+        } else if ( c == '+' ) {
+            r = re_concat(ts, r, re_estrella(ts, r));
+        } else if ( c == '?' ) {
+            r = re_alt(ts, re_epsilon(ts), r);
+        } else {
+            return r;
+        }
+        ts->iter++;
+    }
+}
+
+static int re_parse_concat(Terminos* ts)
+{
+    int r = re_epsilon(ts);
+    while ( *ts->iter != '\0' && *ts->iter != '|' && *ts->iter != ')' ) {
+        r = re_concat(ts, r, re_parse_repeticion(ts));
+    }
+    return r;
+}
+
+static int re_parse_alt(Terminos* ts)
+{
+    int r = re_parse_concat(ts);
+    while ( *ts->iter == '|' ) {
+        ts->iter++;
+        r = re_alt(ts, r, re_parse_concat(ts));
+    }
+    return r;
+}
+
+// Llena el AF con el automata de las derivadas de la expresion. Regresa el
+// numero de terminos distintos que se construyeron.
+static int cargar_af_de_regex(AF* af, const char* expresion, Arena* temp)
+{
+    Arena hijo = arena_push(temp, MAX_TERMINOS * sizeof(Termino) + 2 * MAX_TERMINOS * sizeof(int) +
+                            MAX_TERMINOS * sizeof(int) + sizeof(Terminos));
+    Terminos* ts = arena_alloc_elem(&hijo, Terminos);
+    ts->terminos = arena_alloc_array(&hijo, MAX_TERMINOS, Termino);
+    ts->tabla = arena_alloc_array(&hijo, 2 * MAX_TERMINOS, int);
+    int* estado_de = arena_alloc_array(&hijo, MAX_TERMINOS, int);  // 0 si el termino no es estado.
+    ts->temp = temp;
+    re_vacio(ts);
+    re_epsilon(ts);
+
+    ts->iter = expresion;
+    int inicial = re_parse_alt(ts);
+    if ( *ts->iter != '\0' ) {
+        panico("Sobra un ')' en la expresion regular.");
+    }
+
+    af_iniciar(af);
+    memcpy(af->en_alfabeto, ts->en_alfabeto, sizeof(ts->en_alfabeto));
+    int estados[MAX_NUM_ESTADOS];  // Termino de cada estado.
+    int n = 2;
+    estados[1] = inicial;
+    estado_de[inicial] = 1;
+    for ( int q = 1; q < n; ++q ) {
+        af->finales[q] = ts->terminos[estados[q]].anulable;
+        for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+            if ( !af->en_alfabeto[c] ) {
+                continue;
+            }
+            int d = re_derivada(ts, estados[q], (char)c);
+            if ( ts->terminos[d].tipo == TERMINO_vacio ) {
+                continue;  // Estado error
+            }
+            if ( !estado_de[d] ) {
+                if ( n >= MAX_NUM_ESTADOS ) {
+                    panico("El automata de la expresion tiene demasiados estados.");
+                }
+                estado_de[d] = n;
+                estados[n++] = d;
+            }
+            af->tabla[q][c] = (estado_t)estado_de[d];
+        }
+    }
+    af->num_estados = n;
+    int num_terminos = ts->num_terminos;
+    arena_pop(&hijo);
+    af_cerrar(af, temp);
+    return num_terminos;
+}
+
+// ==== Minimizacion
+
+// Marcar alcanzables, en el orden en que se encuentran desde el estado inicial.
+static void marcar_alcanzables(AF* af, Minimizado* m)
+{
+    int es_alcanzable[MAX_NUM_ESTADOS] = { 0 };
+    m->num_alcanzables = 0;
+    m->alcanzables[m->num_alcanzables++] = 1;  // El estado inicial es alcanzable
+    es_alcanzable[1] = 1;
+    int fijo = 0;
+    while ( !fijo ) {
+        fijo = 1;
+        for (int qi = 0; qi < m->num_alcanzables; ++qi) {
+            int q = m->alcanzables[qi];
+            for (int ai = 0; ai < af->num_simbolos; ++ai) {
+                int a = af->alfabeto[ai];
+                int p = af->tabla[q][a];
+                if ( !es_alcanzable[p] ) {
+                    // Encontramos un nuevo estado alcanzable.
+                    es_alcanzable[p] = 1;
+                    m->alcanzables[m->num_alcanzables++] = p;
+                    fijo = 0;
+                }
+            }
+        }
+    }
+}
+
+// Los estados alcanzables que no pueden llegar a un estado final (muertos)
+// son todos equivalentes al estado error. En lugar de dejar que el punto fijo
+// lo descubra, se juntan desde antes: se busca hacia atras desde los finales
+// sobre el grafo de transiciones invertido, y cada estado muerto se sustituye
+// por el primer estado muerto alcanzable (el sumidero).
+//
+// Llena efectivo[q] para cada alcanzable q (q mismo si esta vivo, o el
+// sumidero) y `vivos` con los alcanzables vivos mas el sumidero, en el orden
+// de alcanzables. Regresa cuantos estados quedaron en `vivos`.
+static int podar_muertos(AF* af, Minimizado* m, int* efectivo, int* vivos, Arena* temp)
+{
+    int n = af->num_estados;
+    int ac = m->num_alcanzables;
+    int ns = af->num_simbolos;
+
+    // Grafo invertido: los predecesores de q estan en preds[inicio[q] .. inicio[q + 1]).
+    Arena hijo = arena_push(temp, (2 * n + 2 + ac * ns) * sizeof(int));
+    int* inicio = arena_alloc_array(&hijo, n + 1, int);
+    int* lleno = arena_alloc_array(&hijo, n + 1, int);
+    int* preds = arena_alloc_array(&hijo, ac * ns, int);
+    for ( int qi = 0; qi < ac; ++qi ) {
+        for ( int ai = 0; ai < ns; ++ai ) {
+            inicio[af->tabla[m->alcanzables[qi]][af->alfabeto[ai]] + 1]++;
+        }
+    }
+    for ( int q = 0; q < n; ++q ) {
+        inicio[q + 1] += inicio[q];
+    }
+    for ( int qi = 0; qi < ac; ++qi ) {
+        int q = m->alcanzables[qi];
+        for ( int ai = 0; ai < ns; ++ai ) {
+            int p = af->tabla[q][af->alfabeto[ai]];
+            preds[inicio[p] + lleno[p]++] = q;
+        }
+    }
+
+    // Buscar hacia atras desde los finales.
+    int es_vivo[MAX_NUM_ESTADOS] = { 0 };
+    int pila[MAX_NUM_ESTADOS];
+    int num_pila = 0;
+    for ( int qi = 0; qi < ac; ++qi ) {
+        int q = m->alcanzables[qi];
+        if ( af->finales[q] ) {
+            es_vivo[q] = 1;
+            pila[num_pila++] = q;
+        }
+    }
+    while ( num_pila ) {
+        int q = pila[--num_pila];
+        for ( int i = inicio[q]; i < inicio[q + 1]; ++i ) {
+            int p = preds[i];
+            if ( !es_vivo[p] ) {
+                es_vivo[p] = 1;
+                pila[num_pila++] = p;
+            }
+        }
+    }
+    arena_pop(&hijo);
+
+    int sumidero = -1;
+    int num_vivos = 0;
+    for ( int qi = 0; qi < ac; ++qi ) {
+        int q = m->alcanzables[qi];
+        if ( es_vivo[q] ) {
+            efectivo[q] = q;
+            vivos[num_vivos++] = q;
+        } else {
+            if ( sumidero < 0 ) {
+                sumidero = q;
+                vivos[num_vivos++] = q;
+            }
+            efectivo[q] = sumidero;
+        }
+    }
+    return num_vivos;
+}
+
+static void minimizar_tabla(AF* af, Minimizado* m, Arena* temp)
+{
+    memset(m, 0, sizeof(Minimizado));
+
+    medir_inicio(ETAPA_alcanzables);
+    marcar_alcanzables(af, m);
+
+    int efectivo[MAX_NUM_ESTADOS];
+    int vivos[MAX_NUM_ESTADOS];
+    int nv = podar_muertos(af, m, efectivo, vivos, temp);
+    medir_fin(ETAPA_alcanzables);
+    medir_inicio(ETAPA_punto_fijo);
+
+    // Tabla inicialmente en zeros, de estados distinguibles
+    int n = af->num_estados;
+    Arena hijo = arena_push(temp, n * n);
+    uint8_t* distinguibles = arena_alloc_array(&hijo, n * n, uint8_t);
+
+    // Marcar finales y no finales como distinguibles.
+    for ( int pi = 0; pi < nv; ++pi ) {
+        for ( int qi = pi + 1; qi < nv; ++qi ) {
+            int p = vivos[pi];
+            int q = vivos[qi];
+            if ( af->finales[p] != af->finales[q] ) {
+                marcar_distinguibles(distinguibles, n, p, q);
+            }
+        }
+    }
+
+    // Punto fijo: marcar (q,p) como distinguibles si d(p,a) y
+    // d(q,a) son distinguibles para a en el alfabeto
+
+    int fijo = 0;
+    while (!fijo) {
+        fijo = 1;
+        for ( int pi = 0; pi < nv; ++pi ) {
+            for ( int qi = pi + 1; qi < nv; ++qi ) {
+                int p = vivos[pi];
+                int q = vivos[qi];
+                if ( !son_distinguibles(distinguibles, n, p, q) ) {
+                    for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+                        int a = af->alfabeto[ai];
+                        int pa = efectivo[af->tabla[p][a]];
+                        int qa = efectivo[af->tabla[q][a]];
+                        if ( son_distinguibles(distinguibles, n, pa, qa) ) {
+                            fijo = 0;
+                            marcar_distinguibles(distinguibles, n, p, q);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    medir_fin(ETAPA_punto_fijo);
+
+    // Crear clases.
+    // La primera clase tiene al estado inicial. Cada estado va a la primera
+    // clase cuyo representante es equivalente, o crea una clase nueva.
+    medir_inicio(ETAPA_clases);
+    for ( int q = 0; q < MAX_NUM_ESTADOS; ++q ) {
+        m->clase_de[q] = -1;
+    }
+    for ( int pi = 0; pi < m->num_alcanzables; ++pi ) {
+        int p = m->alcanzables[pi];
+        for ( int ci = 0; ci < m->num_clases; ++ci ) {
+            if ( !son_distinguibles(distinguibles, n, efectivo[m->representante[ci]], efectivo[p]) ) {
+                m->clase_de[p] = ci;
+                break;
+            }
+        }
+        if ( m->clase_de[p] < 0 ) {  // No pertence a alguna clase. Crear una nueva.
+            m->representante[m->num_clases] = p;
+            m->clase_de[p] = m->num_clases++;
+        }
+    }
+
+    arena_pop(&hijo);
+
+    // Para hacer las cosas mas legibles, encontrar la clase que tiene el estado error...
+    m->clase_error = m->clase_de[0];
+    medir_fin(ETAPA_clases);
+}
+
+// Camino rapido para automatas de hasta 64 estados: cada conjunto de estados
+// es un uint64_t. Es el algoritmo de Hopcroft: cada bloque de la particion es
+// una mascara, la preimagen de un bloque con un simbolo es el OR de las
+// preimagenes de sus estados, y partir un bloque B con una preimagen X es
+// B & X y B & ~X.
+static void minimizar_bits(AF* af, Minimizado* m, Arena* temp)
+{
+    assert(af->num_estados <= 64);
+    memset(m, 0, sizeof(Minimizado));
+    medir_inicio(ETAPA_alcanzables);
+    marcar_alcanzables(af, m);
+    medir_fin(ETAPA_alcanzables);
+    medir_inicio(ETAPA_punto_fijo);
+
+    int ns = af->num_simbolos;
+    int ac = m->num_alcanzables;
+    Arena hijo = arena_push(temp, ns * 64 * sizeof(uint64_t) + 64 * ns + 2 * 64 * ns * sizeof(int));
+    uint64_t* pre = arena_alloc_array(&hijo, ns * 64, uint64_t);  // pre[a * 64 + q]: los que van a q con a.
+    uint8_t* en_lista = arena_alloc_array(&hijo, 64 * ns, uint8_t);
+    int* lista = arena_alloc_array(&hijo, 2 * 64 * ns, int);
+    int num_lista = 0;
+
+    for ( int qi = 0; qi < ac; ++qi ) {
+        int q = m->alcanzables[qi];
+        for ( int ai = 0; ai < ns; ++ai ) {
+            pre[ai * 64 + af->tabla[q][af->alfabeto[ai]]] |= (uint64_t)1 << q;
+        }
+    }
+
+    // Particion inicial: un bloque por cada valor de finales.
+    uint64_t bloques[64];
+    int bloque_de[64];
+    int nb = 0;
+    for ( int qi = 0; qi < ac; ++qi ) {
+        int q = m->alcanzables[qi];
+        int b = 0;
+        while ( b < nb && af->finales[bit_menor(bloques[b])] != af->finales[q] ) {
+            ++b;
+        }
+        if ( b == nb ) {
+            bloques[nb++] = 0;
+        }
+        bloques[b] |= (uint64_t)1 << q;
+        bloque_de[q] = b;
+    }
+
+    // Lista de trabajo: (bloque, simbolo) con los que hay que partir. Al
+    // principio todos menos el bloque mas grande.
+    int mayor = 0;
+    for ( int b = 1; b < nb; ++b ) {
+        if ( contar_bits(bloques[b]) > contar_bits(bloques[mayor]) ) {
+            mayor = b;
+        }
+    }
+    for ( int b = 0; b < nb; ++b ) {
+        for ( int ai = 0; ai < ns && b != mayor; ++ai ) {
+            en_lista[b * ns + ai] = 1;
+            lista[num_lista++] = b * ns + ai;
+        }
+    }
+
+    while ( num_lista ) {
+        int e = lista[--num_lista];
+        en_lista[e] = 0;
+        int ai = e % ns;
+
+        uint64_t X = 0;
+        for ( uint64_t bits = bloques[e / ns]; bits; bits &= bits - 1 ) {
+            X |= pre[ai * 64 + bit_menor(bits)];
+        }
+
+        int num_bloques = nb;
+        for ( int b = 0; b < num_bloques; ++b ) {
+            uint64_t dentro = bloques[b] & X;
+            uint64_t fuera = bloques[b] & ~X;
+            if ( !dentro || !fuera ) {
+                continue;
+            }
+            bloques[b] = dentro;
+            bloques[nb] = fuera;
+            for ( uint64_t bits = fuera; bits; bits &= bits - 1 ) {
+                bloque_de[bit_menor(bits)] = nb;
+            }
+            // Si (b, a) estaba pendiente, ahora tambien (nuevo, a). Si no,
+            // basta con la mitad mas chica.
+            int chico = contar_bits(dentro) <= contar_bits(fuera) ? b : nb;
+            for ( int aj = 0; aj < ns; ++aj ) {
+                int agregar = en_lista[b * ns + aj] ? nb : chico;
+                if ( !en_lista[agregar * ns + aj] ) {
+                    en_lista[agregar * ns + aj] = 1;
+                    lista[num_lista++] = agregar * ns + aj;
+                }
+            }
+            ++nb;
+        }
+    }
+    arena_pop(&hijo);
+    medir_fin(ETAPA_punto_fijo);
+
+    // Crear clases, numeradas en el orden de los alcanzables.
+    medir_inicio(ETAPA_clases);
+    int numero[64];
+    for ( int b = 0; b < nb; ++b ) {
+        numero[b] = -1;
+    }
+    for ( int q = 0; q < MAX_NUM_ESTADOS; ++q ) {
+        m->clase_de[q] = -1;
+    }
+    for ( int qi = 0; qi < ac; ++qi ) {
+        int q = m->alcanzables[qi];
+        int b = bloque_de[q];
+        if ( numero[b] < 0 ) {
+            numero[b] = m->num_clases;
+            m->representante[m->num_clases++] = q;
+        }
+        m->clase_de[q] = numero[b];
+    }
+    m->clase_error = m->clase_de[0];
+    medir_fin(ETAPA_clases);
+}
+
+// ==== Cache de resultados
+//
+// Con --cache DIR, el resultado de cada minimizacion se guarda en DIR, en un
+// archivo nombrado por el hash del automata interpretado (alfabeto,
+// transiciones y finales). Si el mismo automata vuelve a aparecer se lee el
+// resultado en lugar de minimizar.
+//
+// - Los archivos se escriben a un temporal y luego se renombran, asi que
+//   varios procesos pueden compartir el directorio sin ver archivos a medias.
+// - Leer un resultado actualiza su fecha de modificacion. Cuando el
+//   directorio pasa de su limite se borran los menos usados (LRU).
+
+#define CACHE_MAGIA     0x4d313050  // "P01M"
+#define CACHE_VERSION   (2 | (sizeof(estado_t) << 8))
+#define CACHE_LIMITE    (16 * 1024 * 1024)
+
+typedef struct Cache_s {
+    char*       dir;
+    int64_t     limite;
+    int64_t     tam;        // Aproximado. Otros procesos tambien escriben.
+    int32_t     temporales;
+    SglMutex*   mutex;
+} Cache;
+
+static uint64_t af_hash(AF* af)
+{
+    uint64_t h = FNV_BASE;
+    h = fnv_entero(h, af->num_estados);
+    h = fnv_entero(h, af->num_simbolos);
+    for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+        int a = af->alfabeto[ai];
+        h = fnv_entero(h, a);
+        if ( af->num_intervalos ) {
+            h = fnv_entero(fnv_entero(h, (int32_t)af->desde[a]), (int32_t)af->hasta[a]);
+        }
+    }
+    for ( int q = 0; q < af->num_estados; ++q ) {
+        h = fnv_entero(h, af->finales[q]);
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            h = fnv_entero(h, af->tabla[q][af->alfabeto[ai]]);
+        }
+    }
+    return h;
+}
+
+#if defined(__linux__) || defined(__MACH__)
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+
+typedef struct EntradaCache_s {
+    char    nombre[32];
+    time_t  usado;
+    int64_t tam;
+} EntradaCache;
+
+static int es_nombre_de_cache(const char* nombre)
+{
+    size_t n = strlen(nombre);
+    return n == 20 && strcmp(nombre + 16, ".min") == 0;
+}
+
+static int comparar_entradas(const void* a, const void* b)
+{
+    time_t ta = ((const EntradaCache*)a)->usado;
+    time_t tb = ((const EntradaCache*)b)->usado;
+    return (ta > tb) - (ta < tb);
+}
+
+// Recorre el directorio, recalcula su tamaño y borra los resultados menos
+// usados hasta quedar debajo del limite. Regresa el nuevo tamaño.
+static int64_t cache_desalojar(Cache* c, int64_t objetivo)
+{
+    DIR* dir = opendir(c->dir);
+    if ( !dir ) {
+        return 0;
+    }
+    EntradaCache* entradas = NULL;
+    int64_t total = 0;
+    char path[1024];
+    struct dirent* d;
+    while ( (d = readdir(dir)) != NULL ) {
+        struct stat st;
+        if ( !es_nombre_de_cache(d->d_name) ) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", c->dir, d->d_name);
+        if ( stat(path, &st) == 0 ) {
+            EntradaCache e;
+            strcpy(e.nombre, d->d_name);
+            e.usado = st.st_mtime;
+            e.tam = (int64_t)st.st_size;
+            sb_push(entradas, e);
+            total += e.tam;
+        }
+    }
+    closedir(dir);
+
+    if ( total > objetivo ) {
+        qsort(entradas, sb_count(entradas), sizeof(EntradaCache), comparar_entradas);
+        for ( int i = 0; i < sb_count(entradas) && total > objetivo; ++i ) {
+            snprintf(path, sizeof(path), "%s/%s", c->dir, entradas[i].nombre);
+            // Si otro proceso ya lo borro no pasa nada.
+            if ( remove(path) == 0 ) {
+                total -= entradas[i].tam;
+            }
+        }
+    }
+    if ( entradas ) {
+        free(sgl__sbraw(entradas));
+    }
+    return total;
+}
+
+static void cache_iniciar(Cache* c, char* dir, int64_t limite)
+{
+    c->dir = dir;
+    c->limite = limite;
+    c->temporales = 0;
+    c->mutex = sgl_create_mutex();
+    mkdir(dir, 0777);  // Puede que ya exista.
+    c->tam = cache_desalojar(c, limite);
+}
+
+static void cache_path(Cache* c, uint64_t hash, char* path, size_t sz)
+{
+    snprintf(path, sz, "%s/%016" PRIx64 ".min", c->dir, hash);
+}
+
+// Formato del archivo:
+//      uint32 magia, uint32 version, uint64 hash, uint32 num_alcanzables
+//      estado_t [num_alcanzables][2]   (estado, clase) en orden de alcanzables
+// La version incluye el ancho de estado_t, porque depende de como se compilo.
+static int cache_buscar(Cache* c, AF* af, uint64_t hash, Minimizado* m)
+{
+    char path[1024];
+    cache_path(c, hash, path, sizeof(path));
+    FILE* fd = fopen(path, "rb");
+    if ( !fd ) {
+        return 0;
+    }
+    uint32_t magia = 0, version = 0;
+    uint64_t h = 0;
+    uint32_t n = 0;
+    estado_t pares[MAX_NUM_ESTADOS][2];
+    int ok = fread(&magia, sizeof(magia), 1, fd) == 1 &&
+            fread(&version, sizeof(version), 1, fd) == 1 &&
+            fread(&h, sizeof(h), 1, fd) == 1 &&
+            fread(&n, sizeof(n), 1, fd) == 1 &&
+            magia == CACHE_MAGIA && version == CACHE_VERSION && h == hash &&
+            n > 0 && n <= MAX_NUM_ESTADOS &&
+            fread(pares, sizeof(pares[0]), n, fd) == n;
+    fclose(fd);
+
+    if ( ok ) {
+        memset(m, 0, sizeof(Minimizado));
+        for ( int q = 0; q < MAX_NUM_ESTADOS; ++q ) {
+            m->clase_de[q] = -1;
+        }
+        for ( uint32_t i = 0; i < n && ok; ++i ) {
+            int q = pares[i][0];
+            int ci = pares[i][1];
+            if ( q >= af->num_estados || m->clase_de[q] >= 0 || ci > m->num_clases ) {
+                ok = 0;
+                break;
+            }
+            m->alcanzables[m->num_alcanzables++] = q;
+            m->clase_de[q] = ci;
+            if ( ci == m->num_clases ) {
+                m->representante[m->num_clases++] = q;
+            }
+        }
+        m->clase_error = m->clase_de[0];
+    }
+    if ( ok ) {
+        utime(path, NULL);  // Marcar como usado recientemente.
+    }
+    return ok;
+}
+
+static void cache_guardar(Cache* c, uint64_t hash, Minimizado* m)
+{
+    char path[1024];
+    char temporal[1024];
+    cache_path(c, hash, path, sizeof(path));
+
+    sgl_mutex_lock(c->mutex);
+    int32_t id = c->temporales++;
+    sgl_mutex_unlock(c->mutex);
+    snprintf(temporal, sizeof(temporal), "%s/.tmp-%d-%d", c->dir, (int)getpid(), id);
+
+    FILE* fd = fopen(temporal, "wb");
+    if ( !fd ) {
+        return;
+    }
+    uint32_t magia = CACHE_MAGIA, version = CACHE_VERSION;
+    uint32_t n = (uint32_t)m->num_alcanzables;
+    estado_t pares[MAX_NUM_ESTADOS][2];
+    for ( uint32_t i = 0; i < n; ++i ) {
+        pares[i][0] = (estado_t)m->alcanzables[i];
+        pares[i][1] = (estado_t)m->clase_de[m->alcanzables[i]];
+    }
+    int ok = fwrite(&magia, sizeof(magia), 1, fd) == 1 &&
+            fwrite(&version, sizeof(version), 1, fd) == 1 &&
+            fwrite(&hash, sizeof(hash), 1, fd) == 1 &&
+            fwrite(&n, sizeof(n), 1, fd) == 1 &&
+            fwrite(pares, sizeof(pares[0]), n, fd) == n;
+    ok = (fclose(fd) == 0) && ok;
+    if ( !ok || rename(temporal, path) != 0 ) {
+        remove(temporal);
+        return;
+    }
+
+    int64_t tam = sizeof(magia) + sizeof(version) + sizeof(hash) + sizeof(n) + n * sizeof(pares[0]);
+    sgl_mutex_lock(c->mutex);
+    c->tam += tam;
+    if ( c->tam > c->limite ) {
+        // Dejar espacio para no recorrer el directorio en cada escritura.
+        c->tam = cache_desalojar(c, c->limite - c->limite / 4);
+    }
+    sgl_mutex_unlock(c->mutex);
+}
+
+#else  // Sin cache en otras plataformas.
+
+static void cache_iniciar(Cache* c, char* dir, int64_t limite)
+{
+    panico("--cache no esta soportado en esta plataforma");
+}
+
+static int cache_buscar(Cache* c, AF* af, uint64_t hash, Minimizado* m)
+{
+    return 0;
+}
+
+static void cache_guardar(Cache* c, uint64_t hash, Minimizado* m)
+{
+}
+
+#endif
+
+// Opciones de la linea de comandos.
+typedef struct Opciones_s {
+    Cache*  cache;      // NULL si no se usa --cache
+    int     canonico;
+    int     dedup;
+    int     motor;
+    char**  pruebas;    // (stretchy buffer) Cadenas de --probar
+    int     orden;
+    char*   perfil;
+    Arena   arena_salida;
+} Opciones;
+static Opciones g_opciones;
+
+static void minimizar(AF* af, Minimizado* m, Arena* temp)
+{
+    int motor = g_opciones.motor;
+    if ( motor == MOTOR_auto ) {
+        motor = af->num_estados <= 64 ? MOTOR_bits : MOTOR_tabla;
+    }
+    if ( motor == MOTOR_bits ) {
+        if ( af->num_estados > 64 ) {
+            panico("El motor bits solo sirve para automatas de hasta 64 estados.");
+        }
+        minimizar_bits(af, m, temp);
+    } else {
+        minimizar_tabla(af, m, temp);
+    }
+}
+
+// Minimiza, o lee el resultado de la cache si se esta usando una.
+static void minimizar_con_cache(AF* af, Minimizado* m, Arena* temp)
+{
+    Cache* cache = g_opciones.cache;
+    if ( !cache ) {
+        minimizar(af, m, temp);
+        return;
+    }
+    uint64_t hash = af_hash(af);
+    if ( !cache_buscar(cache, af, hash, m) ) {
+        minimizar(af, m, temp);
+        cache_guardar(cache, hash, m);
+    }
+}
+
+// ==== Forma canonica
+//
+// La numeracion de las clases depende del orden de los alcanzables, asi que
+// dos automatas equivalentes pueden salir numerados distinto. La forma
+// canonica renumera las clases con un BFS desde la clase inicial, tomando los
+// simbolos en orden, sin el estado error y sin los simbolos que solo llevan
+// al estado error. Los simbolos son intervalos de puntos de codigo: los
+// simbolos vecinos que llevan a las mismas clases desde todas se juntan, para
+// que `a-c` y `a`, `b`, `c` por separado den la misma forma. Dos automatas
+// aceptan el mismo lenguaje si y solo si sus formas canonicas son iguales, asi
+// que se pueden comparar por hash.
+
+typedef struct Canonico_s {
+    int         num_estados;
+    int         num_simbolos;
+    uint32_t    desde[MAX_COLUMNAS];  // El simbolo ai es [desde[ai], hasta[ai]].
+    uint32_t    hasta[MAX_COLUMNAS];
+    int         tabla[MAX_NUM_ESTADOS][MAX_COLUMNAS];  // Por indice de simbolo. -1 es el estado error.
+    int         finales[MAX_NUM_ESTADOS];
+    uint64_t    hash;
+} Canonico;
+
+// El estado error del automata minimizado. Si el estado 0 no es alcanzable
+// puede haber otra clase que haga el mismo papel: no final y que solo va a si
+// misma.
+static int clase_sumidero(AF* af, Minimizado* m)
+{
+    if ( m->clase_error >= 0 ) {
+        return m->clase_error;
+    }
+    for ( int ci = 0; ci < m->num_clases; ++ci ) {
+        int p = m->representante[ci];
+        int es_sumidero = !af->finales[p];
+        for ( int ai = 0; ai < af->num_simbolos && es_sumidero; ++ai ) {
+            es_sumidero = m->clase_de[af->tabla[p][af->alfabeto[ai]]] == ci;
+        }
+        if ( es_sumidero ) {
+            return ci;
+        }
+    }
+    return -1;
+}
+
+static void canonizar(AF* af, Minimizado* m, Canonico* c)
+{
+    memset(c, 0, sizeof(Canonico));
+    int sumidero = clase_sumidero(af, m);
+
+    // Simbolos utiles: los que llevan a algun lado desde alguna clase. Cada
+    // uno se junta con el anterior si son vecinos y se comportan igual.
+    int utiles[MAX_COLUMNAS];  // Una columna del AF por cada simbolo.
+    for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+        int a = af->alfabeto[ai];
+        int util = 0;
+        for ( int ci = 0; ci < m->num_clases && !util; ++ci ) {
+            util = ci != sumidero && m->clase_de[af->tabla[m->representante[ci]][a]] != sumidero;
+        }
+        if ( !util ) {
+            continue;
+        }
+        uint32_t desde = af->num_intervalos ? af->desde[a] : (uint32_t)a;
+        uint32_t hasta = af->num_intervalos ? af->hasta[a] : (uint32_t)a;
+        int k = c->num_simbolos - 1;
+        int juntar = k >= 0 && c->hasta[k] + 1 == desde;
+        for ( int ci = 0; ci < m->num_clases && juntar; ++ci ) {
+            int p = m->representante[ci];
+            juntar = m->clase_de[af->tabla[p][a]] == m->clase_de[af->tabla[p][utiles[k]]];
+        }
+        if ( juntar ) {
+            c->hasta[k] = hasta;
+        } else {
+            k = c->num_simbolos++;
+            utiles[k] = a;
+            c->desde[k] = desde;
+            c->hasta[k] = hasta;
+        }
+    }
+
+    // BFS desde la clase inicial.
+    int numero[MAX_NUM_ESTADOS];
+    int cola[MAX_NUM_ESTADOS];
+    for ( int ci = 0; ci < m->num_clases; ++ci ) {
+        numero[ci] = -1;
+    }
+    if ( sumidero != 0 ) {
+        numero[0] = c->num_estados;
+        cola[c->num_estados++] = 0;
+    }
+    for ( int i = 0; i < c->num_estados; ++i ) {
+        int ci = cola[i];
+        int p = m->representante[ci];
+        c->finales[i] = af->finales[p];
+        for ( int ai = 0; ai < c->num_simbolos; ++ai ) {
+            int cj = m->clase_de[af->tabla[p][utiles[ai]]];
+            if ( cj == sumidero ) {
+                c->tabla[i][ai] = -1;
+                continue;
+            }
+            if ( numero[cj] < 0 ) {
+                numero[cj] = c->num_estados;
+                cola[c->num_estados++] = cj;
+            }
+            c->tabla[i][ai] = numero[cj];
+        }
+    }
+
+    uint64_t h = FNV_BASE;
+    h = fnv_entero(h, c->num_estados);
+    h = fnv_entero(h, c->num_simbolos);
+    h = fnv(h, c->desde, c->num_simbolos * sizeof(uint32_t));
+    h = fnv(h, c->hasta, c->num_simbolos * sizeof(uint32_t));
+    for ( int q = 0; q < c->num_estados; ++q ) {
+        h = fnv_entero(h, c->finales[q]);
+        for ( int ai = 0; ai < c->num_simbolos; ++ai ) {
+            h = fnv_entero(h, c->tabla[q][ai]);
+        }
+    }
+    c->hash = h;
+}
+
+static void imprimir_canonico(Canonico* c)
+{
+    char simbolo[TAM_TEXTO_INTERVALO];
+    sgl_log("    ==== Forma canonica (hash %016" PRIx64 ") ====\n", c->hash);
+    for ( int q = 0; q < c->num_estados; ++q ) {
+        for ( int ai = 0; ai < c->num_simbolos; ++ai ) {
+            texto_intervalo(simbolo, c->desde[ai], c->hasta[ai]);
+            if ( c->tabla[q][ai] >= 0 ) {
+                sgl_log("d(q%d, %s) = q%d\n", q, simbolo, c->tabla[q][ai]);
+            } else {
+                sgl_log("d(q%d, %s) = E\n", q, simbolo);
+            }
+        }
+    }
+    sgl_log("Estados finales: [ ");
+    for ( int q = 0; q < c->num_estados; ++q ) {
+        if ( c->finales[q] ) {
+            sgl_log("q%d ", q);
+        }
+    }
+    sgl_log("]\n");
+}
+
+// Tabla hash de formas canonicas ya vistas, para --dedup. Direccionamiento
+// abierto; el hash canonico ya esta bien distribuido.
+typedef struct Vistos_s {
+    uint64_t*   hashes;  // 0 es un lugar vacio.
+    char**      paths;
+    int64_t     capacidad;
+    int64_t     cuenta;
+} Vistos;
+
+static int64_t vistos_lugar(Vistos* v, uint64_t hash)
+{
+    int64_t i = (int64_t)(hash & (uint64_t)(v->capacidad - 1));
+    while ( v->hashes[i] && v->hashes[i] != hash ) {
+        i = (i + 1) & (v->capacidad - 1);
+    }
+    return i;
+}
+
+// Regresa el archivo donde ya se habia visto el hash, o NULL si es nuevo.
+static char* vistos_agregar(Vistos* v, uint64_t hash, char* path)
+{
+    if ( !hash ) {
+        hash = 1;
+    }
+    if ( 2 * (v->cuenta + 1) > v->capacidad ) {
+        Vistos nuevo = { 0 };
+        nuevo.capacidad = v->capacidad ? 2 * v->capacidad : 1024;
+        nuevo.hashes = (uint64_t*)calloc((size_t)nuevo.capacidad, sizeof(uint64_t));
+        nuevo.paths = (char**)calloc((size_t)nuevo.capacidad, sizeof(char*));
+        if ( !nuevo.hashes || !nuevo.paths ) {
+            panico("No hay memoria para la tabla de automatas vistos");
+        }
+        for ( int64_t i = 0; i < v->capacidad; ++i ) {
+            if ( v->hashes[i] ) {
+                int64_t j = vistos_lugar(&nuevo, v->hashes[i]);
+                nuevo.hashes[j] = v->hashes[i];
+                nuevo.paths[j] = v->paths[i];
+            }
+        }
+        nuevo.cuenta = v->cuenta;
+        free(v->hashes);
+        free(v->paths);
+        *v = nuevo;
+    }
+    int64_t i = vistos_lugar(v, hash);
+    if ( v->hashes[i] ) {
+        return v->paths[i];
+    }
+    v->hashes[i] = hash;
+    v->paths[i] = path;
+    v->cuenta++;
+    return NULL;
+}
+
+// ==== Equivalencia
+//
+// Algoritmo de Hopcroft y Karp: une el estado inicial de A con el de B y
+// sigue las transiciones por pares. Cada vez que se unen dos conjuntos
+// distintos se agrega el par a la cola; si algun par junta un estado final con
+// uno no final, los automatas no son equivalentes. Como cada union reduce el
+// numero de conjuntos, hay a lo mas |A| + |B| pares, asi que es casi lineal
+// en lugar de las dos minimizaciones cuadraticas.
+//
+// Los estados de B se numeran despues de los de A en el union-find.
+
+typedef struct ParEquiv_s {
+    int p;          // Estado de A
+    int q;          // Estado de B
+    int padre;      // Indice del par del que venimos, -1 para el inicial.
+    char simbolo;   // Simbolo con el que llegamos desde el padre.
+} ParEquiv;
+
+static int uf_buscar(int* padres, int x)
+{
+    while ( padres[x] != x ) {
+        padres[x] = padres[padres[x]];
+        x = padres[x];
+    }
+    return x;
+}
+
+// Regresa 1 si son equivalentes. Si no, deja en `contraejemplo` una cadena
+// (terminada en 0) que acepta uno y el otro no.
+static int son_equivalentes(AF* a, AF* b, char* contraejemplo, int tam_contraejemplo)
+{
+    int padres[2 * MAX_NUM_ESTADOS];
+    for ( int i = 0; i < 2 * MAX_NUM_ESTADOS; ++i ) {
+        padres[i] = i;
+    }
+
+    // Union de los alfabetos. Si un simbolo no esta en un automata su tabla
+    // ya lleva al estado error.
+    int alfabeto[NUM_ASCII_CHARS];
+    int num_simbolos = 0;
+    for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+        if ( a->en_alfabeto[c] || b->en_alfabeto[c] ) {
+            alfabeto[num_simbolos++] = c;
+        }
+    }
+
+    ParEquiv pares[2 * MAX_NUM_ESTADOS];
+    int num_pares = 0;
+    pares[num_pares++] = (ParEquiv){ 1, 1, -1, 0 };
+    padres[MAX_NUM_ESTADOS + 1] = 1;
+
+    int diferente = -1;
+    if ( !a->finales[1] != !b->finales[1] ) {
+        diferente = 0;
+    }
+    for ( int i = 0; i < num_pares && diferente < 0; ++i ) {
+        for ( int ai = 0; ai < num_simbolos && diferente < 0; ++ai ) {
+            int c = alfabeto[ai];
+            int p = a->tabla[pares[i].p][c];
+            int q = b->tabla[pares[i].q][c];
+            int rp = uf_buscar(padres, p);
+            int rq = uf_buscar(padres, MAX_NUM_ESTADOS + q);
+            if ( rp == rq ) {
+                continue;
+            }
+            padres[rq] = rp;
+            assert(num_pares < (int)sgl_array_count(pares));
+            pares[num_pares++] = (ParEquiv){ p, q, i, c };
+            if ( !a->finales[p] != !b->finales[q] ) {
+                diferente = num_pares - 1;
+            }
+        }
+    }
+    if ( diferente < 0 ) {
+        return 1;
+    }
+
+    // Reconstruir la cadena de atras para adelante.
+    int largo = 0;
+    for ( int i = diferente; pares[i].padre >= 0; i = pares[i].padre ) {
+        ++largo;
+    }
+    if ( largo >= tam_contraejemplo ) {
+        largo = tam_contraejemplo - 1;  // No deberia pasar: hay a lo mas 2*MAX_NUM_ESTADOS pares.
+    }
+    contraejemplo[largo] = '\0';
+    int k = largo;
+    for ( int i = diferente; pares[i].padre >= 0 && k > 0; i = pares[i].padre ) {
+        contraejemplo[--k] = pares[i].simbolo;
+    }
+    return 0;
+}
+
+static int procesar_equivalencia(char* path_a, char* path_b)
+{
+    static AF a;
+    static AF b;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+    if ( !cargar_af(&a, path_a, &temp) || !cargar_af(&b, path_b, &temp) ) {
+        panico("No se pudieron leer los automatas");
+    }
+    if ( a.num_intervalos || b.num_intervalos ) {
+        panico("--equiv todavia no acepta automatas con rangos.");
+    }
+    char contraejemplo[2 * MAX_NUM_ESTADOS + 1];
+    if ( son_equivalentes(&a, &b, contraejemplo, sizeof(contraejemplo)) ) {
+        sgl_log("%s y %s aceptan el mismo lenguaje\n", path_a, path_b);
+        return 1;
+    }
+    // Ver quien acepta el contraejemplo.
+    int p = 1;
+    for ( char* c = contraejemplo; *c; ++c ) {
+        p = a.tabla[p][(unsigned char)*c];
+    }
+    sgl_log("%s y %s no son equivalentes\n", path_a, path_b);
+    sgl_log("Contraejemplo: \"%s\" (lo acepta %s)\n", contraejemplo, a.finales[p] ? path_a : path_b);
+    return 0;
+}
+
+// ==== Ejecucion
+//
+// El automata minimizado en una tabla compacta para ejecutarlo. Las filas son
+// las clases y las columnas los simbolos del alfabeto, mas la columna 0 para
+// cualquier caracter fuera del alfabeto. Los estados se guardan en 8, 16 o 32
+// bits, lo mas angosto donde caben las clases, para que la tabla ocupe menos
+// cache. DEFINIR_TABLA_MIN genera el llenado y el ciclo de ejecucion para cada
+// ancho, y las funciones tabla_min_* escogen la variante.
+//
+// Si el automata tiene rangos, la cadena se lee como UTF-8 y la columna de
+// cada caracter se busca entre los intervalos en lugar de en `columna`.
+
+typedef struct TablaMin_s {
+    int         ancho;          // Bytes por estado: 1, 2 o 4.
+    int         num_estados;    // Incluye al estado error.
+    int         num_columnas;
+    int         inicial;
+    int         error;
+    uint8_t     columna[256];   // Byte -> columna. 0 para los que no estan en el alfabeto.
+    void*       delta;          // delta[q * num_columnas + columna]
+    uint32_t*   finales;
+    int         num_intervalos; // 0 si se usa `columna`. Si no, hay num_columnas - 1.
+    uint32_t*   desde;          // La columna 1 + i es [desde[i], hasta[i]].
+    uint32_t*   hasta;
+} TablaMin;
+
+static int tabla_min_columna(TablaMin* t, uint32_t cp)
+{
+    if ( cp == UTF8_INVALIDO ) {
+        return 0;
+    }
+    int izq = 0;
+    int der = t->num_intervalos;
+    while ( der - izq > 1 ) {
+        int medio = (izq + der) / 2;
+        if ( t->desde[medio] <= cp ) {
+            izq = medio;
+        } else {
+            der = medio;
+        }
+    }
+    return (t->desde[izq] <= cp && cp <= t->hasta[izq]) ? izq + 1 : 0;
+}
+
+#define DEFINIR_TABLA_MIN(T, SUFIJO)                                                    \
+    static void tabla_min_llenar_##SUFIJO(TablaMin* t, AF* af, Minimizado* m)           \
+    {                                                                                   \
+        T* delta = (T*)t->delta;                                                        \
+        for ( int q = 0; q < t->num_estados; ++q ) {                                    \
+            delta[q * t->num_columnas] = (T)t->error;                                   \
+            for ( int ai = 0; ai < af->num_simbolos; ++ai ) {                           \
+                T destino = (T)t->error;                                                \
+                if ( q < m->num_clases ) {                                              \
+                    destino = (T)m->clase_de[af->tabla[m->representante[q]][af->alfabeto[ai]]]; \
+                }                                                                       \
+                delta[q * t->num_columnas + 1 + ai] = destino;                          \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+    static uint32_t tabla_min_ejecutar_##SUFIJO(TablaMin* t, const char* s, size_t n)   \
+    {                                                                                   \
+        const T* delta = (const T*)t->delta;                                            \
+        const uint8_t* columna = t->columna;                                            \
+        const int nc = t->num_columnas;                                                 \
+        T q = (T)t->inicial;                                                            \
+        for ( size_t i = 0; i < n; ++i ) {                                              \
+            q = delta[q * nc + columna[(uint8_t)s[i]]];                                 \
+        }                                                                               \
+        return t->finales[q];                                                           \
+    }                                                                                   \
+    static uint32_t tabla_min_ejecutar_rangos_##SUFIJO(TablaMin* t, const char* s, size_t n) \
+    {                                                                                   \
+        const T* delta = (const T*)t->delta;                                            \
+        const int nc = t->num_columnas;                                                 \
+        const char* fin = s + n;                                                        \
+        T q = (T)t->inicial;                                                            \
+        while ( s < fin ) {                                                             \
+            q = delta[q * nc + tabla_min_columna(t, utf8_siguiente(&s, fin))];          \
+        }                                                                               \
+        return t->finales[q];                                                           \
+    }
+
+DEFINIR_TABLA_MIN(uint8_t,  8)
+DEFINIR_TABLA_MIN(uint16_t, 16)
+DEFINIR_TABLA_MIN(uint32_t, 32)
+
+static void tabla_min_construir(TablaMin* t, AF* af, Minimizado* m, Arena* arena)
+{
+    memset(t, 0, sizeof(TablaMin));
+    t->num_estados = m->num_clases;
+    t->error = m->clase_error;
+    if ( t->error < 0 ) {
+        // Se necesita un estado error para los caracteres fuera del alfabeto.
+        t->error = t->num_estados++;
+    }
+    t->inicial = 0;
+    t->num_columnas = af->num_simbolos + 1;
+    t->ancho = t->num_estados <= 256 ? 1 : t->num_estados <= 65536 ? 2 : 4;
+    if ( af->num_intervalos ) {
+        t->num_intervalos = af->num_simbolos;
+        t->desde = arena_alloc_array(arena, af->num_simbolos, uint32_t);
+        t->hasta = arena_alloc_array(arena, af->num_simbolos, uint32_t);
+        if ( !t->desde || !t->hasta ) {
+            panico("No hay memoria para la tabla del automata minimizado.");
+        }
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            t->desde[ai] = af->desde[af->alfabeto[ai]];
+            t->hasta[ai] = af->hasta[af->alfabeto[ai]];
+        }
+    } else {
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            t->columna[(uint8_t)af->alfabeto[ai]] = (uint8_t)(ai + 1);
+        }
+    }
+    t->delta = arena_alloc_bytes(arena, (size_t)t->num_estados * t->num_columnas * t->ancho);
+    t->finales = arena_alloc_array(arena, t->num_estados, uint32_t);
+    if ( !t->delta || !t->finales ) {
+        panico("No hay memoria para la tabla del automata minimizado.");
+    }
+    for ( int q = 0; q < m->num_clases; ++q ) {
+        t->finales[q] = (uint32_t)af->finales[m->representante[q]];
+    }
+    switch ( t->ancho ) {
+    case 1: tabla_min_llenar_8(t, af, m); break;
+    case 2: tabla_min_llenar_16(t, af, m); break;
+    default: tabla_min_llenar_32(t, af, m); break;
+    }
+}
+
+// Regresa el valor de finales del estado donde termina: 0 si rechaza.
+static uint32_t tabla_min_ejecutar(TablaMin* t, const char* s, size_t n)
+{
+    if ( t->num_intervalos ) {
+        switch ( t->ancho ) {
+        case 1: return tabla_min_ejecutar_rangos_8(t, s, n);
+        case 2: return tabla_min_ejecutar_rangos_16(t, s, n);
+        default: return tabla_min_ejecutar_rangos_32(t, s, n);
+        }
+    }
+    switch ( t->ancho ) {
+    case 1: return tabla_min_ejecutar_8(t, s, n);
+    case 2: return tabla_min_ejecutar_16(t, s, n);
+    default: return tabla_min_ejecutar_32(t, s, n);
+    }
+}
+
+// ==== Orden de los estados
+//
+// Las clases salen numeradas en el orden de los alcanzables, que no tiene que
+// ver con como se recorre el automata. Al ejecutarlo, los estados que se
+// visitan uno tras otro pueden quedar lejos en la tabla. Este paso opcional
+// renumera las clases antes de imprimir o construir la tabla:
+//  - bfs, dfs: en el orden en que se recorren desde q0, simbolos en orden.
+//  - perfil: se ejecutan cadenas de ejemplo contando cuantas veces se usa cada
+//    transicion, y se acomodan en cadenas: de cada estado se sigue a su
+//    sucesor mas usado que falte; si no hay, se empieza con el estado mas
+//    visitado que falte.
+// En todos los casos q0 sigue siendo el inicial, el estado error va al final
+// y los que no se alcanzaron se agregan en orden de BFS.
+
+// orden[i] es la clase que queda en la posicion i.
+static void renumerar_clases(Minimizado* m, int* orden)
+{
+    int nuevo[MAX_NUM_ESTADOS];
+    int representante[MAX_NUM_ESTADOS];
+    for ( int i = 0; i < m->num_clases; ++i ) {
+        nuevo[orden[i]] = i;
+        representante[i] = m->representante[orden[i]];
+    }
+    memcpy(m->representante, representante, m->num_clases * sizeof(int));
+    for ( int qi = 0; qi < m->num_alcanzables; ++qi ) {
+        int q = m->alcanzables[qi];
+        m->clase_de[q] = nuevo[m->clase_de[q]];
+    }
+    if ( m->clase_error >= 0 ) {
+        m->clase_error = nuevo[m->clase_error];
+    }
+}
+
+static int clase_sucesora(AF* af, Minimizado* m, int ci, int ai)
+{
+    return m->clase_de[af->tabla[m->representante[ci]][af->alfabeto[ai]]];
+}
+
+// Agrega al orden, en BFS, las clases que falten y se alcanzan desde las que
+// ya estan.
+static int completar_bfs(AF* af, Minimizado* m, int* orden, int n, int* puesta)
+{
+    for ( int i = 0; i < n; ++i ) {
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            int cj = clase_sucesora(af, m, orden[i], ai);
+            if ( !puesta[cj] ) {
+                puesta[cj] = 1;
+                orden[n++] = cj;
+            }
+        }
+    }
+    return n;
+}
+
+static int orden_dfs(AF* af, Minimizado* m, int* orden, int* puesta)
+{
+    int n = 0;
+    int pila[MAX_NUM_ESTADOS * 2];
+    int siguiente[MAX_NUM_ESTADOS] = { 0 };  // Siguiente simbolo a explorar de cada clase.
+    int num_pila = 0;
+    puesta[0] = 1;
+    orden[n++] = 0;
+    pila[num_pila++] = 0;
+    while ( num_pila ) {
+        int ci = pila[num_pila - 1];
+        if ( siguiente[ci] == af->num_simbolos ) {
+            --num_pila;
+            continue;
+        }
+        int cj = clase_sucesora(af, m, ci, siguiente[ci]++);
+        if ( !puesta[cj] ) {
+            puesta[cj] = 1;
+            orden[n++] = cj;
+            pila[num_pila++] = cj;
+        }
+    }
+    return n;
+}
+
+static int orden_perfil(AF* af, Minimizado* m, char* path, int* orden, int* puesta, Arena* temp)
+{
+    int ns = af->num_simbolos;
+    int columna[MAX_COLUMNAS];  // Columna del AF -> indice de simbolo.
+    for ( int ai = 0; ai < ns; ++ai ) {
+        columna[af->alfabeto[ai]] = ai;
+    }
+
+    Arena hijo = arena_push(temp, (MAX_NUM_ESTADOS + MAX_NUM_ESTADOS * ns) * sizeof(uint64_t));
+    uint64_t* visitas = arena_alloc_array(&hijo, MAX_NUM_ESTADOS, uint64_t);
+    uint64_t* usos = arena_alloc_array(&hijo, MAX_NUM_ESTADOS * ns, uint64_t);  // usos[clase * ns + simbolo]
+
+    char ventana[TAM_VENTANA];
+    SglLineReader lector;
+    if ( sgl_line_reader_open(&lector, path, ventana, TAM_VENTANA) != 0 ) {
+        panico("No se pudo leer el archivo de perfil");
+    }
+    char* linea;
+    while ( (linea = sgl_line_reader_next(&lector)) != NULL ) {
+        int ci = 0;
+        visitas[ci]++;
+        const char* fin = linea + strlen(linea);
+        for ( const char* c = linea; c < fin; ) {
+            int a = af_siguiente_columna(af, &c, fin);
+            int ai = a >= 0 ? columna[a] : -1;
+            if ( ai < 0 || ci == m->clase_error ) {
+                break;  // Ya no sale del estado error.
+            }
+            usos[ci * ns + ai]++;
+            ci = clase_sucesora(af, m, ci, ai);
+            visitas[ci]++;
+        }
+    }
+    if ( lector.error ) {
+        panico("Hay una linea demasiado larga en el archivo de perfil.");
+    }
+    sgl_line_reader_close(&lector);
+
+    int n = 0;
+    int actual = 0;
+    puesta[0] = 1;
+    orden[n++] = 0;
+    for (;;) {
+        // El sucesor mas usado que falte...
+        int mejor = -1;
+        uint64_t mejor_usos = 0;
+        for ( int ai = 0; ai < ns; ++ai ) {
+            int cj = clase_sucesora(af, m, actual, ai);
+            if ( !puesta[cj] && usos[actual * ns + ai] > mejor_usos ) {
+                mejor = cj;
+                mejor_usos = usos[actual * ns + ai];
+            }
+        }
+        // ... o el estado mas visitado que falte.
+        if ( mejor < 0 ) {
+            uint64_t mejor_visitas = 0;
+            for ( int ci = 0; ci < m->num_clases; ++ci ) {
+                if ( !puesta[ci] && visitas[ci] > mejor_visitas ) {
+                    mejor = ci;
+                    mejor_visitas = visitas[ci];
+                }
+            }
+        }
+        if ( mejor < 0 ) {
+            break;
+        }
+        puesta[mejor] = 1;
+        orden[n++] = mejor;
+        actual = mejor;
+    }
+    arena_pop(&hijo);
+    return n;
+}
+
+static void ordenar_clases(AF* af, Minimizado* m, int tipo, char* perfil, Arena* temp)
+{
+    if ( tipo == ORDEN_descubrimiento || m->num_clases == 0 ) {
+        return;
+    }
+    int orden[MAX_NUM_ESTADOS];
+    int puesta[MAX_NUM_ESTADOS] = { 0 };
+    int n = 0;
+    if ( m->clase_error >= 0 ) {
+        puesta[m->clase_error] = 1;  // Se agrega al final.
+    }
+    if ( m->clase_error == 0 ) {
+        return;  // El lenguaje es vacio. Solo hay un estado.
+    }
+    switch ( tipo ) {
+    case ORDEN_bfs: {
+        puesta[0] = 1;
+        orden[n++] = 0;
+        break;
+    }
+    case ORDEN_dfs: {
+        n = orden_dfs(af, m, orden, puesta);
+        break;
+    }
+    case ORDEN_perfil: {
+        n = orden_perfil(af, m, perfil, orden, puesta, temp);
+        break;
+    }
+    }
+    n = completar_bfs(af, m, orden, n, puesta);
+    if ( m->clase_error >= 0 ) {
+        orden[n++] = m->clase_error;
+    }
+    assert(n == m->num_clases);
+    renumerar_clases(m, orden);
+}
+
+// ==== Tablas en C
+//
+// Para automatas fijos que van dentro de otro programa: en lugar de leer y
+// minimizar el csv al arrancar, se genera un header al compilar (ver el
+// Makefile). El header tiene la tabla de TablaMin como arreglos `static
+// const` alineados a la linea de cache, y una funcion NOMBRE_acepta() que la
+// ejecuta. El compilador puede plegar las tablas como constantes.
+
+static int es_identificador(const char* s)
+{
+    if ( !isalpha((unsigned char)*s) && *s != '_' ) {
+        return 0;
+    }
+    for ( ; *s; ++s ) {
+        if ( !isalnum((unsigned char)*s) && *s != '_' ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void emitir_c(FILE* fd, char* nombre, char* origen, TablaMin* t)
+{
+    char mayusculas[128];
+    size_t largo = strlen(nombre);
+    if ( largo >= sizeof(mayusculas) || !es_identificador(nombre) ) {
+        panico("El nombre de la tabla tiene que ser un identificador de C.");
+    }
+    for ( size_t i = 0; i <= largo; ++i ) {
+        mayusculas[i] = (char)toupper((unsigned char)nombre[i]);
+    }
+    const char* tipo = t->ancho == 1 ? "uint8_t" : t->ancho == 2 ? "uint16_t" : "uint32_t";
+
+    fprintf(fd, "// Generado por p01 --emitir-c desde %s. No editar.\n", origen);
+    fprintf(fd, "//\n");
+    fprintf(fd, "// %s_acepta(s, n) ejecuta el automata minimizado con los n bytes de s y\n", nombre);
+    fprintf(fd, "// regresa distinto de 0 si los acepta.\n\n");
+    fprintf(fd, "#pragma once\n\n#include <stddef.h>\n#include <stdint.h>\n\n");
+    fprintf(fd, "#ifndef P01_ALINEADO\n");
+    fprintf(fd, "#if defined(_MSC_VER)\n#define P01_ALINEADO __declspec(align(64))\n");
+    fprintf(fd, "#else\n#define P01_ALINEADO __attribute__((aligned(64)))\n#endif\n");
+    fprintf(fd, "#endif\n\n");
+
+    fprintf(fd, "#define %s_NUM_ESTADOS  %d\n", mayusculas, t->num_estados);
+    fprintf(fd, "#define %s_NUM_COLUMNAS %d\n", mayusculas, t->num_columnas);
+    fprintf(fd, "#define %s_INICIAL      %d\n", mayusculas, t->inicial);
+    fprintf(fd, "#define %s_ERROR        %d\n\n", mayusculas, t->error);
+
+    fprintf(fd, "// Byte -> columna. La columna 0 es para los bytes fuera del alfabeto.\n");
+    fprintf(fd, "P01_ALINEADO static const uint8_t %s_columna[256] = {\n", nombre);
+    for ( int i = 0; i < 256; ++i ) {
+        fprintf(fd, "%s%3d,%s", i % 16 ? " " : "    ", t->columna[i], i % 16 == 15 ? "\n" : "");
+    }
+    fprintf(fd, "};\n\n");
+
+    fprintf(fd, "// delta[q * %s_NUM_COLUMNAS + columna]\n", mayusculas);
+    fprintf(fd, "P01_ALINEADO static const %s %s_delta[%d] = {\n", tipo, nombre, t->num_estados * t->num_columnas);
+    for ( int q = 0; q < t->num_estados; ++q ) {
+        fprintf(fd, "    /* q%d */", q);
+        for ( int c = 0; c < t->num_columnas; ++c ) {
+            uint32_t d = t->ancho == 1 ? ((uint8_t*)t->delta)[q * t->num_columnas + c] :
+                         t->ancho == 2 ? ((uint16_t*)t->delta)[q * t->num_columnas + c] :
+                                         ((uint32_t*)t->delta)[q * t->num_columnas + c];
+            fprintf(fd, " %" PRIu32 ",", d);
+        }
+        fprintf(fd, "\n");
+    }
+    fprintf(fd, "};\n\n");
+
+    fprintf(fd, "P01_ALINEADO static const uint32_t %s_finales[%d] = {", nombre, t->num_estados);
+    for ( int q = 0; q < t->num_estados; ++q ) {
+        fprintf(fd, "%s%" PRIu32 ",", q % 16 ? " " : "\n    ", t->finales[q]);
+    }
+    fprintf(fd, "\n};\n\n");
+
+    fprintf(fd, "static inline uint32_t %s_acepta(const char* s, size_t n)\n{\n", nombre);
+    fprintf(fd, "    %s q = %s_INICIAL;\n", tipo, mayusculas);
+    fprintf(fd, "    for ( size_t i = 0; i < n; ++i ) {\n");
+    fprintf(fd, "        q = %s_delta[q * %s_NUM_COLUMNAS + %s_columna[(uint8_t)s[i]]];\n", nombre, mayusculas, nombre);
+    fprintf(fd, "    }\n");
+    fprintf(fd, "    return %s_finales[q];\n}\n", nombre);
+}
+
+// Sin path_salida, escribe en la salida estandar.
+static void procesar_emitir_c(char* nombre, char* path, char* path_salida)
+{
+    static AF af;
+    static Minimizado min;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+    if ( !cargar_af(&af, path, &temp) ) {
+        panico("No se pudo leer el automata");
+    }
+    if ( af.num_intervalos ) {
+        panico("--emitir-c todavia no acepta automatas con rangos.");
+    }
+    minimizar(&af, &min, &temp);
+    ordenar_clases(&af, &min, g_opciones.orden, g_opciones.perfil, &temp);
+    TablaMin t;
+    tabla_min_construir(&t, &af, &min, &temp);
+
+    FILE* fd = path_salida ? fopen(path_salida, "w") : stdout;
+    if ( !fd ) {
+        panico("No se pudo escribir el header");
+    }
+    emitir_c(fd, nombre, path, &t);
+    if ( path_salida && fclose(fd) != 0 ) {
+        panico("No se pudo escribir el header");
+    }
+}
+
+// ==== Salida
+
+// Escribe en *texto (un stretchy buffer) si no es NULL, y si no en la salida.
+static void escribir(char** texto, const char* formato, ...)
+{
+    va_list args;
+    va_start(args, formato);
+    if ( !texto ) {
+        vprintf(formato, args);
+    } else {
+        va_list copia;
+        va_copy(copia, args);
+        int n = vsnprintf(NULL, 0, formato, copia);
+        va_end(copia);
+        char* destino = sb_add(*texto, n + 1);
+        vsnprintf(destino, (size_t)n + 1, formato, args);
+        sgl__sbcount(*texto) -= 1;  // Sin el 0 del final.
+    }
+    va_end(args);
+}
+
+static void imprimir_resultado(AF* af, Minimizado* m, char** texto)
+{
+    if ( af->estados_afn ) {
+        escribir(texto, "AFN con %d estados, determinizado a %d estados\n", af->estados_afn, af->num_estados - 1);
+    }
+
+    // Output del alfabeto del automata:
+    char simbolo[TAM_TEXTO_INTERVALO];
+    escribir(texto, "El alfabeto es: ");
+    for (int ai = 0; ai < af->num_simbolos; ++ai) {
+        escribir(texto, "%s", texto_simbolo(simbolo, af, af->alfabeto[ai]));
+        if (ai < af->num_simbolos - 1) {
+            escribir(texto, ", ");
+        } else {
+            escribir(texto, "\n");
+        }
+    }
+
+    escribir(texto, "Alcanzables: ");
+    for (int qi = 0; qi < m->num_alcanzables; ++qi) {
+        int q = m->alcanzables[qi];
+        escribir(texto, "%d", q);
+        if (qi == m->num_alcanzables - 1) {
+            escribir(texto, "\n");
+        } else {
+            escribir(texto, ", ");
+        }
+    }
+
+    // Imprimir informacion de estados equivalentes..
+    for ( int pi = 0; pi < m->num_alcanzables; ++pi ) {
+        for ( int qi = pi + 1; qi < m->num_alcanzables; ++qi ) {
+            int p = m->alcanzables[pi];
+            int q = m->alcanzables[qi];
+            if ( m->clase_de[p] == m->clase_de[q] ) {
+                escribir(texto, "%d y %d son equivalentes\n", p, q);
+            }
+        }
+    }
+
+    // Imprimir el nuevo autómata.
+
+    escribir(texto, "    ==== El automata minimizado (el estado inicial es q0) ====\n");
+
+    for ( int ci = 0; ci < m->num_clases; ++ci ) {
+        if ( ci == m->clase_error ) {
+            continue;
+        }
+        int p = m->representante[ci];  // Solo nos interesa un elemento, para ver a donde va.
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            int a = af->alfabeto[ai];
+            int transicion = m->clase_de[af->tabla[p][a]];
+            texto_simbolo(simbolo, af, a);
+            // Imprimir.
+            if ( transicion != m->clase_error ) {
+                escribir(texto, "d(q%d, %s) = q%d\n", ci, simbolo, transicion);
+            } else {
+                escribir(texto, "d(q%d, %s) = E\n", ci, simbolo);
+            }
+        }
+    }
+    // Imprimir las transiciones del estado error.
+    for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+        escribir(texto, "d(E, %s) = E\n", texto_simbolo(simbolo, af, af->alfabeto[ai]));
+    }
+
+    // Indicar los estados finales.
+    escribir(texto, "Estados finales: [ ");
+    for ( int ci = 0; ci < m->num_clases; ++ci ) {
+        int p = m->representante[ci];
+        if ( af->finales[p] ) {
+            escribir(texto, "q%d ", ci);
+        }
+    }
+    escribir(texto, "]\n");
+}
+
+// Imprime el resultado de un archivo segun las opciones.
+static void reportar(char* path, AF* af, Minimizado* m)
+{
+    static Vistos vistos;
+    static Canonico c;
+    ordenar_clases(af, m, g_opciones.orden, g_opciones.perfil, &g_opciones.arena_salida);
+    if ( g_opciones.canonico || g_opciones.dedup ) {
+        canonizar(af, m, &c);
+    }
+    if ( g_opciones.dedup ) {
+        char* igual = vistos_agregar(&vistos, c.hash, path);
+        if ( igual ) {
+            sgl_log("Acepta el mismo lenguaje que %s (hash %016" PRIx64 ")\n", igual, c.hash);
+            return;
+        }
+    }
+    imprimir_resultado(af, m, NULL);
+    if ( g_opciones.canonico ) {
+        imprimir_canonico(&c);
+    }
+    if ( sb_count(g_opciones.pruebas) ) {
+        TablaMin t;
+        tabla_min_construir(&t, af, m, &g_opciones.arena_salida);
+        for ( int i = 0; i < sb_count(g_opciones.pruebas); ++i ) {
+            char* cadena = g_opciones.pruebas[i];
+            int acepta = tabla_min_ejecutar(&t, cadena, strlen(cadena)) != 0;
+            sgl_log("\"%s\": %s\n", cadena, acepta ? "acepta" : "rechaza");
+        }
+        arena_reset(&g_opciones.arena_salida);
+    }
+}
+
+// ==== Minimizacion incremental
+//
+// Se mantiene la particion en clases de todos los estados (no solo de los
+// alcanzables) y los predecesores de cada estado, y se actualizan con cada
+// cambio en lugar de volver a minimizar.
+//
+// Un cambio en el estado p se procesa en dos pasos:
+//  - Separar: p sale a una clase propia, y desde ella se separan, como en
+//    Hopcroft, las clases de los predecesores cuyos estados ya no van a la
+//    misma clase. Solo se visitan los predecesores de las clases que se
+//    parten. Queda la particion mas gruesa que respeta las transiciones
+//    nuevas sin juntar nada, que puede ser mas fina que la minima.
+//  - Juntar: si dos clases quedaron equivalentes, la prueba de que lo son
+//    pasa por p (si no, ya lo eran antes del cambio). Se busca con quien se
+//    puede juntar la clase de p y, cada vez que se juntan dos clases, con
+//    quien se pueden juntar los predecesores de la que se vacio. Los
+//    candidatos salen de una huella del lenguaje de cada estado (las
+//    palabras de largo <= PROFUNDIDAD_HUELLA), que se recalcula solo cerca
+//    de p, y se confirman con Hopcroft-Karp sobre las clases.
+// El numero de clases, las etiquetas libres y la lista de etiquetas vivas se
+// mantienen al meter y sacar estados, asi que nada recorre todas las
+// etiquetas posibles.
+//
+// Formato de los cambios, uno por linea (# para comentarios):
+//      + ESTADO, ENTRADA, DESTINO      Agrega o redirige una transicion
+//      - ESTADO, ENTRADA               Quita una transicion (va al estado error)
+//      f ESTADO                        Cambia si el estado es final o no
+
+// Refinamiento de Moore sobre un grafo de n nodos con ns sucesores cada uno
+// (sucesores[i * ns + a]). `bloque` trae la particion inicial, con cualquier
+// etiqueta, y regresa la particion mas gruesa que la refina y respeta las
+// transiciones, con los bloques numerados desde 0. Regresa el numero de bloques.
+static int refinar_moore(int n, int ns, int* sucesores, int* bloque, Arena* temp)
+{
+    int tam_tabla = 1;
+    while ( tam_tabla < 2 * n ) {
+        tam_tabla *= 2;
+    }
+    Arena hijo = arena_push(temp, (n * (ns + 1) + n + tam_tabla) * sizeof(int));
+    int* firmas = arena_alloc_array(&hijo, n * (ns + 1), int);
+    int* nuevo = arena_alloc_array(&hijo, n, int);
+    int* tabla = arena_alloc_array(&hijo, tam_tabla, int);  // Nodo + 1. 0 es un lugar vacio.
+
+    // La firma de un nodo es su bloque y el bloque de cada sucesor. La primera
+    // vuelta solo usa el bloque, para numerar la particion inicial.
+    int num_bloques = -1;
+    int largo = 1;
+    for (;;) {
+        memset(tabla, 0, tam_tabla * sizeof(int));
+        int cuenta = 0;
+        for ( int i = 0; i < n; ++i ) {
+            int* f = firmas + i * (ns + 1);
+            f[0] = bloque[i];
+            for ( int a = 0; a < largo - 1; ++a ) {
+                f[1 + a] = bloque[sucesores[i * ns + a]];
+            }
+            int h = (int)(fnv(FNV_BASE, f, largo * sizeof(int)) & (uint64_t)(tam_tabla - 1));
+            while ( tabla[h] && memcmp(firmas + (tabla[h] - 1) * (ns + 1), f, largo * sizeof(int)) != 0 ) {
+                h = (h + 1) & (tam_tabla - 1);
+            }
+            if ( !tabla[h] ) {
+                tabla[h] = i + 1;
+                nuevo[i] = cuenta++;
+            } else {
+                nuevo[i] = nuevo[tabla[h] - 1];
+            }
+        }
+        memcpy(bloque, nuevo, n * sizeof(int));
+        // Cada vuelta refina la anterior, asi que si no hay mas bloques ya no cambio.
+        if ( cuenta == num_bloques ) {
+            break;
+        }
+        num_bloques = cuenta;
+        largo = ns + 1;
+    }
+    arena_pop(&hijo);
+    return num_bloques;
+}
+
+#define PROFUNDIDAD_HUELLA  3
+#define TAM_CUBETAS_INC     (2 * MAX_NUM_ESTADOS)
+
+typedef struct Incremental_s {
+    AF          af;
+    int         clase[MAX_NUM_ESTADOS];     // Etiqueta de la clase de cada estado.
+
+    // Miembros de cada clase, en listas doblemente ligadas.
+    int         cabeza[MAX_NUM_ESTADOS];
+    int         sig[MAX_NUM_ESTADOS];
+    int         ant[MAX_NUM_ESTADOS];
+    int         tamano[MAX_NUM_ESTADOS];    // 0 si la etiqueta esta libre.
+
+    // Etiquetas vivas (lugar[e] es la posicion de e en vivas) y libres. Las
+    // etiquetas desde nunca_usada no se han usado.
+    int         vivas[MAX_NUM_ESTADOS];
+    int         lugar[MAX_NUM_ESTADOS];
+    int         num_clases;
+    int         libres[MAX_NUM_ESTADOS];
+    int         num_libres;
+    int         nunca_usada;
+
+    Conjunto    preds[MAX_NUM_ESTADOS];     // Predecesores de cada estado, con cualquier simbolo.
+
+    // huella[q][j] es un hash de las palabras de largo <= j que acepta q, asi
+    // que dos estados equivalentes tienen la misma. Cada clase esta en la
+    // cubeta de la huella mas profunda de sus estados (su clave).
+    uint64_t    huella[MAX_NUM_ESTADOS][PROFUNDIDAD_HUELLA + 1];
+    uint64_t    clave[MAX_NUM_ESTADOS];
+    int         cubeta[TAM_CUBETAS_INC];    // Primera etiqueta de la cubeta, -1 si esta vacia.
+    int         num_cubetas;                // En uso: unas 2 por estado, hasta TAM_CUBETAS_INC.
+    int         sig_cubeta[MAX_NUM_ESTADOS];
+    int         ant_cubeta[MAX_NUM_ESTADOS];
+    char        indexada[MAX_NUM_ESTADOS];
+
+    int         padre[MAX_NUM_ESTADOS];     // Union-find de etiquetas. Es la identidad fuera de inc_juntar.
+    int         cuenta[MAX_NUM_ESTADOS];    // Por etiqueta. En 0 fuera de inc_separar.
+    int         visto[MAX_NUM_ESTADOS];     // Por estado: == epoca si ya se vio.
+    int         visto_etiqueta[MAX_NUM_ESTADOS];
+    int         epoca;
+    int         movidos;                    // Estados que cambiaron de clase en el ultimo refinamiento.
+} Incremental;
+
+static void inc_desindexar(Incremental* inc, int e)
+{
+    if ( !inc->indexada[e] ) {
+        return;
+    }
+    inc->indexada[e] = 0;
+    if ( inc->ant_cubeta[e] >= 0 ) {
+        inc->sig_cubeta[inc->ant_cubeta[e]] = inc->sig_cubeta[e];
+    } else {
+        inc->cubeta[inc->clave[e] % inc->num_cubetas] = inc->sig_cubeta[e];
+    }
+    if ( inc->sig_cubeta[e] >= 0 ) {
+        inc->ant_cubeta[inc->sig_cubeta[e]] = inc->ant_cubeta[e];
+    }
+}
+
+// Pone la clase e en la cubeta de la huella de sus estados.
+static void inc_indexar(Incremental* inc, int e)
+{
+    inc_desindexar(inc, e);
+    uint64_t clave = inc->huella[inc->cabeza[e]][PROFUNDIDAD_HUELLA];
+    int c = (int)(clave % inc->num_cubetas);
+    inc->clave[e] = clave;
+    inc->indexada[e] = 1;
+    inc->ant_cubeta[e] = -1;
+    inc->sig_cubeta[e] = inc->cubeta[c];
+    if ( inc->sig_cubeta[e] >= 0 ) {
+        inc->ant_cubeta[inc->sig_cubeta[e]] = e;
+    }
+    inc->cubeta[c] = e;
+}
+
+static int inc_nueva_etiqueta(Incremental* inc)
+{
+    int e = inc->num_libres ? inc->libres[--inc->num_libres] : inc->nunca_usada++;
+    assert(e < MAX_NUM_ESTADOS);
+    inc->cabeza[e] = -1;
+    inc->tamano[e] = 0;
+    inc->indexada[e] = 0;
+    inc->padre[e] = e;
+    return e;
+}
+
+static void inc_meter(Incremental* inc, int q, int etiqueta)
+{
+    if ( inc->tamano[etiqueta]++ == 0 ) {
+        inc->lugar[etiqueta] = inc->num_clases;
+        inc->vivas[inc->num_clases++] = etiqueta;
+    }
+    inc->clase[q] = etiqueta;
+    inc->ant[q] = -1;
+    inc->sig[q] = inc->cabeza[etiqueta];
+    if ( inc->sig[q] >= 0 ) {
+        inc->ant[inc->sig[q]] = q;
+    }
+    inc->cabeza[etiqueta] = q;
+}
+
+static void inc_sacar(Incremental* inc, int q)
+{
+    int e = inc->clase[q];
+    if ( inc->ant[q] >= 0 ) {
+        inc->sig[inc->ant[q]] = inc->sig[q];
+    } else {
+        inc->cabeza[e] = inc->sig[q];
+    }
+    if ( inc->sig[q] >= 0 ) {
+        inc->ant[inc->sig[q]] = inc->ant[q];
+    }
+    inc->clase[q] = -1;
+    if ( --inc->tamano[e] == 0 ) {
+        // La clase se vacio: su etiqueta queda libre.
+        int ultima = inc->vivas[--inc->num_clases];
+        inc->vivas[inc->lugar[e]] = ultima;
+        inc->lugar[ultima] = inc->lugar[e];
+        inc->libres[inc->num_libres++] = e;
+        inc_desindexar(inc, e);
+    }
+}
+
+static void inc_mover(Incremental* inc, int q, int etiqueta)
+{
+    inc_sacar(inc, q);
+    inc_meter(inc, q, etiqueta);
+    ++inc->movidos;
+}
+
+// Quita p de los predecesores de q si ya no tiene transiciones a q.
+static void inc_revisar_arista(Incremental* inc, int p, int q)
+{
+    AF* af = &inc->af;
+    for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+        if ( af->tabla[p][af->alfabeto[ai]] == q ) {
+            return;
+        }
+    }
+    conj_quitar(&inc->preds[q], p);
+}
+
+static uint64_t inc_huella(Incremental* inc, int q, int j)
+{
+    AF* af = &inc->af;
+    uint64_t h = fnv_entero(FNV_BASE, af->finales[q]);
+    if ( j > 0 ) {
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            h = fnv(h, &inc->huella[af->tabla[q][af->alfabeto[ai]]][j - 1], sizeof(uint64_t));
+        }
+    }
+    return h;
+}
+
+// Vuelve a llenar las cubetas, con unas 2 por estado para que solo se limpien
+// las que se usan.
+static void inc_reindexar(Incremental* inc)
+{
+    inc->num_cubetas = 16;
+    while ( inc->num_cubetas < 2 * inc->af.num_estados && inc->num_cubetas < TAM_CUBETAS_INC ) {
+        inc->num_cubetas = min(2 * inc->num_cubetas, TAM_CUBETAS_INC);
+    }
+    for ( int c = 0; c < inc->num_cubetas; ++c ) {
+        inc->cubeta[c] = -1;
+    }
+    for ( int i = 0; i < inc->num_clases; ++i ) {
+        inc->indexada[inc->vivas[i]] = 0;
+        inc_indexar(inc, inc->vivas[i]);
+    }
+}
+
+// Calcula las huellas de todos los estados y vuelve a llenar las cubetas. Al
+// principio y cuando crece el alfabeto.
+static void inc_calcular_huellas(Incremental* inc)
+{
+    for ( int j = 0; j <= PROFUNDIDAD_HUELLA; ++j ) {
+        for ( int q = 0; q < inc->af.num_estados; ++q ) {
+            inc->huella[q][j] = inc_huella(inc, q, j);
+        }
+    }
+    inc_reindexar(inc);
+}
+
+// Minimiza por completo el automata en inc->af. Solo al principio.
+static void inc_iniciar(Incremental* inc, Arena* temp)
+{
+    AF* af = &inc->af;
+    int n = af->num_estados;
+    int ns = af->num_simbolos;
+    inc->num_clases = 0;
+    inc->num_libres = 0;
+    inc->nunca_usada = 0;
+    inc->movidos = 0;
+    memset(inc->preds, 0, n * sizeof(Conjunto));
+
+    Arena hijo = arena_push(temp, (n * ns + n) * sizeof(int));
+    int* sucesores = arena_alloc_array(&hijo, n * ns, int);
+    int* bloque = arena_alloc_array(&hijo, n, int);
+    for ( int q = 0; q < n; ++q ) {
+        bloque[q] = af->finales[q];
+        for ( int ai = 0; ai < ns; ++ai ) {
+            int p = af->tabla[q][af->alfabeto[ai]];
+            sucesores[q * ns + ai] = p;
+            conj_agregar(&inc->preds[p], q);
+        }
+    }
+    int num_bloques = refinar_moore(n, ns, sucesores, bloque, temp);
+    // Las etiquetas nuevas salen en orden, asi que la etiqueta es el bloque.
+    for ( int b = 0; b < num_bloques; ++b ) {
+        inc_nueva_etiqueta(inc);
+    }
+    for ( int q = n - 1; q >= 0; --q ) {
+        inc_meter(inc, q, bloque[q]);
+    }
+    arena_pop(&hijo);
+    inc_calcular_huellas(inc);
+}
+
+// Agrega los estados hasta q (sin transiciones, no finales). Tienen el mismo
+// lenguaje que el estado error, asi que van en su clase.
+static void inc_crear_estados(Incremental* inc, int q)
+{
+    AF* af = &inc->af;
+    if ( q >= MAX_NUM_ESTADOS ) {
+        panico("Estado invalido\n");
+    }
+    while ( af->num_estados <= q ) {
+        int nuevo = af->num_estados++;
+        af->finales[nuevo] = 0;
+        memset(&inc->preds[nuevo], 0, sizeof(Conjunto));
+        if ( af->num_simbolos > 0 ) {
+            conj_agregar(&inc->preds[0], nuevo);
+        }
+        memcpy(inc->huella[nuevo], inc->huella[0], sizeof(inc->huella[0]));
+        inc_meter(inc, nuevo, inc->clase[0]);
+    }
+    if ( 2 * af->num_estados > inc->num_cubetas && inc->num_cubetas < TAM_CUBETAS_INC ) {
+        inc_reindexar(inc);
+    }
+}
+
+// Agrega un simbolo al alfabeto. Todos los estados van al estado error con el,
+// asi que las clases no cambian, pero todas las huellas si.
+static void inc_agregar_simbolo(Incremental* inc, int c)
+{
+    AF* af = &inc->af;
+    if ( af->en_alfabeto[c] ) {
+        return;
+    }
+    af->en_alfabeto[c] = 1;
+    af->num_simbolos = 0;
+    for ( int ai = 0; ai < NUM_ASCII_CHARS; ++ai ) {
+        if ( af->en_alfabeto[ai] ) {
+            af->alfabeto[af->num_simbolos++] = ai;
+        }
+    }
+    for ( int q = 0; q < af->num_estados; ++q ) {
+        conj_agregar(&inc->preds[0], q);
+    }
+    inc_calcular_huellas(inc);
+}
+
+static void inc_transicion(Incremental* inc, int q, int c, int destino)
+{
+    AF* af = &inc->af;
+    inc_crear_estados(inc, max(q, destino));
+    inc_agregar_simbolo(inc, c);
+    int antes = af->tabla[q][c];
+    af->tabla[q][c] = destino;
+    conj_agregar(&inc->preds[destino], q);
+    inc_revisar_arista(inc, q, antes);
+}
+
+// Saca p a una clase propia y separa, desde ella, las clases cuyos estados
+// ya no van a la misma clase con algun simbolo. Antes del cambio la particion
+// respetaba las transiciones y solo cambiaron las de p, asi que basta empezar
+// con {p}. De cada clase que se parte se mueve la parte mas chica, que es la
+// que se agrega a pendientes.
+static void inc_separar(Incremental* inc, int p)
+{
+    AF* af = &inc->af;
+    if ( inc->tamano[inc->clase[p]] == 1 ) {
+        return;
+    }
+    int pendientes[MAX_NUM_ESTADOS];
+    int miembros[MAX_NUM_ESTADOS];
+    int marcados[MAX_NUM_ESTADOS];
+    int tocadas[MAX_NUM_ESTADOS];
+    int destino[MAX_NUM_ESTADOS];
+    int np = 0;
+    int e = inc_nueva_etiqueta(inc);
+    inc_mover(inc, p, e);
+    inc_indexar(inc, e);
+    pendientes[np++] = e;
+    while ( np > 0 ) {
+        int s = pendientes[--np];
+        int nm = 0;
+        for ( int q = inc->cabeza[s]; q >= 0; q = inc->sig[q] ) {
+            miembros[nm++] = q;
+        }
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            int c = af->alfabeto[ai];
+            // Los estados que van a s con c, contados por clase.
+            int nmar = 0;
+            int nt = 0;
+            int antes = np;
+            ++inc->epoca;
+            for ( int i = 0; i < nm; ++i ) {
+                int t = miembros[i];
+                Conjunto* preds = &inc->preds[t];
+                for ( int w = 0; w < CONJ_PALABRAS; ++w ) {
+                    for ( uint64_t bits = preds->w[w]; bits; bits &= bits - 1 ) {
+                        int r = 64 * w + bit_menor(bits);
+                        if ( af->tabla[r][c] == t ) {
+                            inc->visto[r] = inc->epoca;
+                            marcados[nmar++] = r;
+                            if ( inc->cuenta[inc->clase[r]]++ == 0 ) {
+                                tocadas[nt++] = inc->clase[r];
+                            }
+                        }
+                    }
+                }
+            }
+            for ( int i = 0; i < nt; ++i ) {
+                int x = tocadas[i];
+                destino[x] = -1;
+                if ( inc->cuenta[x] < inc->tamano[x] ) {
+                    int nueva = inc_nueva_etiqueta(inc);
+                    if ( 2 * inc->cuenta[x] <= inc->tamano[x] ) {
+                        destino[x] = nueva;
+                    } else {
+                        for ( int q = inc->cabeza[x], siguiente; q >= 0; q = siguiente ) {
+                            siguiente = inc->sig[q];
+                            if ( inc->visto[q] != inc->epoca ) {
+                                inc_mover(inc, q, nueva);
+                            }
+                        }
+                    }
+                    pendientes[np++] = nueva;
+                }
+                inc->cuenta[x] = 0;
+            }
+            for ( int i = 0; i < nmar; ++i ) {
+                int x = inc->clase[marcados[i]];
+                if ( destino[x] >= 0 ) {
+                    inc_mover(inc, marcados[i], destino[x]);
+                }
+            }
+            for ( int i = antes; i < np; ++i ) {
+                inc_indexar(inc, pendientes[i]);
+            }
+        }
+    }
+}
+
+// Recalcula las huellas que pudo cambiar el cambio en p: las de los estados
+// que llegan a p con a lo mas PROFUNDIDAD_HUELLA transiciones. Luego vuelve a
+// poner sus clases en la cubeta que les toca.
+static void inc_actualizar_huellas(Incremental* inc, int p)
+{
+    int bola[MAX_NUM_ESTADOS];
+    int nb = 0;
+    ++inc->epoca;
+    inc->visto[p] = inc->epoca;
+    bola[nb++] = p;
+    for ( int d = 0, inicio = 0; d < PROFUNDIDAD_HUELLA; ++d ) {
+        int fin = nb;
+        for ( int i = inicio; i < fin; ++i ) {
+            Conjunto* preds = &inc->preds[bola[i]];
+            for ( int w = 0; w < CONJ_PALABRAS; ++w ) {
+                for ( uint64_t bits = preds->w[w]; bits; bits &= bits - 1 ) {
+                    int r = 64 * w + bit_menor(bits);
+                    if ( inc->visto[r] != inc->epoca ) {
+                        inc->visto[r] = inc->epoca;
+                        bola[nb++] = r;
+                    }
+                }
+            }
+        }
+        inicio = fin;
+    }
+    // Los estados fuera de la bola no cambian su huella hasta esa profundidad.
+    for ( int j = 0; j <= PROFUNDIDAD_HUELLA; ++j ) {
+        for ( int i = 0; i < nb; ++i ) {
+            inc->huella[bola[i]][j] = inc_huella(inc, bola[i], j);
+        }
+    }
+    for ( int i = 0; i < nb; ++i ) {
+        int e = inc->clase[bola[i]];
+        if ( inc->visto_etiqueta[e] != inc->epoca ) {
+            inc->visto_etiqueta[e] = inc->epoca;
+            inc_indexar(inc, e);
+        }
+    }
+}
+
+static int inc_raiz(Incremental* inc, int e)
+{
+    while ( inc->padre[e] != e ) {
+        e = inc->padre[e];
+    }
+    return e;
+}
+
+// Une las clases de a y b en el union-find, la mas chica bajo la mas grande.
+// Regresa 1 si no estaban unidas.
+static int inc_unir(Incremental* inc, int a, int b, int* unidas, int* nu)
+{
+    a = inc_raiz(inc, a);
+    b = inc_raiz(inc, b);
+    if ( a == b ) {
+        return 0;
+    }
+    if ( inc->tamano[a] < inc->tamano[b] ) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    inc->padre[b] = a;
+    unidas[(*nu)++] = b;
+    return 1;
+}
+
+// Hopcroft-Karp sobre las clases: x y y son equivalentes si al unirlas, y
+// luego unir las clases a las que van con cada simbolo, nunca se unen dos con
+// distinto valor de finales. Si son equivalentes deja las uniones (las
+// etiquetas que quedaron bajo otra estan en unidas) para juntarlas; si no,
+// las deshace.
+static int inc_equivalentes(Incremental* inc, int x, int y, int* unidas, int* num_unidas)
+{
+    AF* af = &inc->af;
+    int pila[2 * MAX_NUM_ESTADOS];
+    int np = 0;
+    int nu = 0;
+    int iguales = 1;
+    inc_unir(inc, x, y, unidas, &nu);
+    pila[np++] = x;
+    pila[np++] = y;
+    while ( np > 0 && iguales ) {
+        int b = pila[--np];
+        int a = pila[--np];
+        int qa = inc->cabeza[a];
+        int qb = inc->cabeza[b];
+        if ( inc->clave[a] != inc->clave[b] || af->finales[qa] != af->finales[qb] ) {
+            iguales = 0;
+            break;
+        }
+        for ( int ai = 0; ai < af->num_simbolos; ++ai ) {
+            int c = af->alfabeto[ai];
+            int sa = inc->clase[af->tabla[qa][c]];
+            int sb = inc->clase[af->tabla[qb][c]];
+            if ( inc_unir(inc, sa, sb, unidas, &nu) ) {
+                pila[np++] = sa;
+                pila[np++] = sb;
+            }
+        }
+    }
+    if ( !iguales ) {
+        for ( int i = 0; i < nu; ++i ) {
+            inc->padre[unidas[i]] = unidas[i];
+        }
+        nu = 0;
+    }
+    *num_unidas = nu;
+    return iguales;
+}
+
+// Junta las clases que quedaron equivalentes despues de separar. Se empieza
+// por la clase de p; cuando se juntan dos clases, los predecesores de los
+// estados que se movieron pueden haber quedado equivalentes a otros, asi que
+// tambien se revisan. Cada clase solo se compara con las de su cubeta.
+static void inc_juntar(Incremental* inc, int p)
+{
+    int cola[MAX_NUM_ESTADOS];
+    int unidas[MAX_NUM_ESTADOS];
+    int nc = 0;
+    ++inc->epoca;
+    inc->visto[p] = inc->epoca;
+    cola[nc++] = p;
+    for ( int i = 0; i < nc; ++i ) {
+        int e = inc->clase[cola[i]];
+        int c = inc->cubeta[inc->clave[e] % inc->num_cubetas];
+        while ( c >= 0 ) {
+            int nu;
+            if ( c == e || inc->clave[c] != inc->clave[e] || !inc_equivalentes(inc, e, c, unidas, &nu) ) {
+                c = inc->sig_cubeta[c];
+                continue;
+            }
+            for ( int k = 0; k < nu; ++k ) {
+                int raiz = inc_raiz(inc, unidas[k]);
+                for ( int q = inc->cabeza[unidas[k]], siguiente; q >= 0; q = siguiente ) {
+                    siguiente = inc->sig[q];
+                    inc_mover(inc, q, raiz);
+                    Conjunto* preds = &inc->preds[q];
+                    for ( int w = 0; w < CONJ_PALABRAS; ++w ) {
+                        for ( uint64_t bits = preds->w[w]; bits; bits &= bits - 1 ) {
+                            int r = 64 * w + bit_menor(bits);
+                            if ( inc->visto[r] != inc->epoca ) {
+                                inc->visto[r] = inc->epoca;
+                                cola[nc++] = r;
+                            }
+                        }
+                    }
+                }
+            }
+            for ( int k = 0; k < nu; ++k ) {
+                inc->padre[unidas[k]] = unidas[k];
+            }
+            // La clase pudo cambiar de etiqueta, y la cubeta de lugar.
+            e = inc->clase[cola[i]];
+            c = inc->cubeta[inc->clave[e] % inc->num_cubetas];
+        }
+    }
+}
+
+// Vuelve a calcular las clases despues de un cambio en el estado p. Regresa
+// el numero de estados que cambiaron de clase.
+static int inc_refinar(Incremental* inc, int p)
+{
+    inc->movidos = 0;
+    inc_separar(inc, p);
+    inc_actualizar_huellas(inc, p);
+    inc_juntar(inc, p);
+    return inc->movidos;
+}
+
+// Numera las clases como lo hace minimizar(): en el orden de los alcanzables.
+static void inc_minimizado(Incremental* inc, Minimizado* m)
+{
+    memset(m, 0, sizeof(Minimizado));
+    marcar_alcanzables(&inc->af, m);
+    int numero[MAX_NUM_ESTADOS];
+    for ( int q = 0; q < MAX_NUM_ESTADOS; ++q ) {
+        numero[q] = -1;
+        m->clase_de[q] = -1;
+    }
+    for ( int i = 0; i < m->num_alcanzables; ++i ) {
+        int q = m->alcanzables[i];
+        int etiqueta = inc->clase[q];
+        if ( numero[etiqueta] < 0 ) {
+            numero[etiqueta] = m->num_clases;
+            m->representante[m->num_clases++] = q;
+        }
+        m->clase_de[q] = numero[etiqueta];
+    }
+    m->clase_error = m->clase_de[0];
+}
+
+static int leer_estado(char** iter)
+{
+    char* tok = sgl_tokenize_inplace(iter, ',');
+    if ( !tok || !sgl_is_number(tok = sgl_strip_whitespace_inplace(tok)) ) {
+        panico("Cambio mal definido: se esperaba un estado.");
+    }
+    int q = atoi(tok);
+    if ( q < 0 ) {
+        q = 0;
+    }
+    if ( q >= MAX_NUM_ESTADOS ) {
+        panico("Estado invalido\n");
+    }
+    return q;
+}
+
+static int leer_entrada(char** iter)
+{
+    char* tok = sgl_tokenize_inplace(iter, ',');
+    if ( !tok ) {
+        panico("Cambio mal definido: se esperaba una entrada.");
+    }
+    tok = sgl_strip_whitespace_inplace(tok);
+    if ( strlen(tok) != 1 || sgl_is_number(tok) || (unsigned char)tok[0] >= NUM_ASCII_CHARS ) {
+        panico("entrada no bien definida (debe ser un caracter ascii no numerico)");
+    }
+    return (unsigned char)tok[0];
+}
+
+// Aplica un cambio y regresa el numero de estados que cambiaron de clase, o
+// -1 si la linea esta vacia.
+static int aplicar_cambio(Incremental* inc, char* linea)
+{
+    linea = sgl_strip_whitespace_inplace(linea);
+    if ( linea[0] == '\0' ) {
+        return -1;
+    }
+    char op = linea[0];
+    char* iter = linea + 1;
+    int q = leer_estado(&iter);
+    if ( q == 0 ) {
+        panico("El estado error no se puede cambiar.");
+    }
+    inc_crear_estados(inc, q);
+    switch ( op ) {
+    case '+': {
+        int c = leer_entrada(&iter);
+        inc_transicion(inc, q, c, leer_estado(&iter));
+        break;
+    }
+    case '-': {
+        int c = leer_entrada(&iter);
+        inc_transicion(inc, q, c, 0);
+        break;
+    }
+    case 'f': {
+        inc->af.finales[q] = !inc->af.finales[q];
+        break;
+    }
+    default: {
+        panico("Cambio desconocido (debe ser +, - o f).");
+    }
+    }
+    if ( sgl_tokenize_inplace(&iter, ',') ) {
+        panico("Mas datos en el cambio de los esperados");
+    }
+    return inc_refinar(inc, q);
+}
+
+static void procesar_incremental(char* path, char* path_cambios)
+{
+    static Incremental inc;
+    static Minimizado min;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+    if ( !cargar_af(&inc.af, path, &temp) ) {
+        panico("No se pudo leer el automata");
+    }
+    if ( inc.af.num_intervalos ) {
+        panico("--incremental todavia no acepta automatas con rangos.");
+    }
+    inc_iniciar(&inc, &temp);
+
+    char ventana[TAM_VENTANA];
+    SglLineReader lector;
+    if ( sgl_line_reader_open(&lector, path_cambios, ventana, TAM_VENTANA) != 0 ) {
+        panico("No se pudo leer el archivo de cambios");
+    }
+    char* linea;
+    while ( (linea = sgl_line_reader_next(&lector)) != NULL ) {
+        if ( linea[0] == '#' ) {
+            continue;
+        }
+        char texto[128];
+        snprintf(texto, sizeof(texto), "%s", linea);
+        int afectados = aplicar_cambio(&inc, linea);
+        if ( afectados >= 0 ) {
+            sgl_log("Cambio \"%s\": %d estados cambiaron de clase, %d clases (con los no alcanzables)\n",
+                    sgl_strip_whitespace_inplace(texto), afectados, inc.num_clases);
+        }
+    }
+    if ( lector.error ) {
+        panico("Hay una linea demasiado larga en el archivo.");
+    }
+    sgl_line_reader_close(&lector);
+
+    sgl_log("\n\n***** Resultado despues de los cambios *****\n");
+    inc_minimizado(&inc, &min);
+    imprimir_resultado(&inc.af, &min, NULL);
+}
+
+// ==== Producto
+//
+// Interseccion, union o diferencia de varios automatas. No se construye el
+// producto completo de |A| x |B| x ... estados:
+//  - Cada automata se minimiza antes, asi que el producto es de clases.
+//  - Solo se exploran las tuplas de clases alcanzables desde la tupla
+//    inicial, con una tabla hash de tupla -> estado.
+//  - La clase muerta de cada componente se marca con -1, y una tupla que ya
+//    no puede aceptar (en la interseccion, si algun componente esta muerto;
+//    en la union, si todos; en la diferencia, si el primero) es el estado
+//    error en cuanto aparece, sin explorarla.
+// El resultado se minimiza como cualquier otro automata.
+//
+// Con PRODUCTO_etiquetas es la union, pero el valor de finales de cada estado
+// es la mascara de componentes que aceptan (bit i para el componente i). Los
+// minimizadores parten por valor de finales, asi que dos estados solo quedan
+// juntos si aceptan exactamente los mismos patrones.
+
+#define MAX_COMPONENTES 31  // Los componentes que aceptan caben en los bits de un int positivo.
+
+enum {
+    PRODUCTO_inter,
+    PRODUCTO_union,
+    PRODUCTO_dif,
+    PRODUCTO_etiquetas
+};
+
+typedef struct Componente_s {
+    AF          af;
+    Minimizado  min;
+    int         sumidero;   // Clase muerta, o -1.
+} Componente;
+
+static int componente_clase(Componente* c, int q)
+{
+    int ci = c->min.clase_de[q];
+    return (ci < 0 || ci == c->sumidero) ? -1 : ci;
+}
+
+static int componente_siguiente(Componente* c, int ci, int a)
+{
+    if ( ci < 0 || !c->af.en_alfabeto[a] ) {
+        return -1;
+    }
+    return componente_clase(c, c->af.tabla[c->min.representante[ci]][a]);
+}
+
+static int producto_muerta(int op, int* tupla, int k)
+{
+    int muertos = 0;
+    for ( int i = 0; i < k; ++i ) {
+        muertos += tupla[i] < 0;
+    }
+    switch ( op ) {
+    case PRODUCTO_inter: return muertos > 0;
+    case PRODUCTO_dif:   return tupla[0] < 0;
+    default:             return muertos == k;
+    }
+}
+
+// `aceptan` tiene un bit por cada componente en estado final.
+static int producto_final(int op, uint32_t aceptan, int k)
+{
+    switch ( op ) {
+    case PRODUCTO_inter: return aceptan == ((uint32_t)1 << k) - 1;
+    case PRODUCTO_union: return aceptan != 0;
+    case PRODUCTO_dif:   return aceptan == 1;
+    default:             return (int)aceptan;
+    }
+}
+
+static void construir_producto(AF* res, Componente* comps, int k, int op, Arena* temp)
+{
+    assert(k <= MAX_COMPONENTES);
+    af_iniciar(res);
+    for ( int i = 0; i < k; ++i ) {
+        for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+            res->en_alfabeto[c] |= comps[i].af.en_alfabeto[c];
+        }
+    }
+
+    size_t tam_tabla = 1;
+    while ( tam_tabla < 2 * MAX_NUM_ESTADOS ) {
+        tam_tabla *= 2;
+    }
+    Arena hijo = arena_push(temp, (MAX_NUM_ESTADOS * k + tam_tabla) * sizeof(int));
+    int* tuplas = arena_alloc_array(&hijo, MAX_NUM_ESTADOS * k, int);  // tuplas[q * k + i]
+    int* valores = arena_alloc_array(&hijo, tam_tabla, int);            // 0 es un lugar vacio.
+
+    int n = 2;  // 0 es el estado error y 1 el inicial.
+    for ( int i = 0; i < k; ++i ) {
+        tuplas[k + i] = componente_clase(&comps[i], 1);
+    }
+    valores[fnv(FNV_BASE, &tuplas[k], k * sizeof(int)) & (tam_tabla - 1)] = 1;
+
+    int t[MAX_COMPONENTES];
+    for ( int q = 1; q < n; ++q ) {
+        int* tq = &tuplas[q * k];
+        res->finales[q] = 0;
+        if ( producto_muerta(op, tq, k) ) {
+            continue;  // Solo puede pasar con el inicial.
+        }
+        uint32_t aceptan = 0;
+        for ( int i = 0; i < k; ++i ) {
+            if ( tq[i] >= 0 && comps[i].af.finales[comps[i].min.representante[tq[i]]] ) {
+                aceptan |= (uint32_t)1 << i;
+            }
+        }
+        res->finales[q] = producto_final(op, aceptan, k);
+
+        for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+            if ( !res->en_alfabeto[c] ) {
+                continue;
+            }
+            for ( int i = 0; i < k; ++i ) {
+                t[i] = componente_siguiente(&comps[i], tq[i], c);
+            }
+            if ( producto_muerta(op, t, k) ) {
+                continue;  // Estado error
+            }
+            uint64_t h = fnv(FNV_BASE, t, k * sizeof(int)) & (tam_tabla - 1);
+            while ( valores[h] && memcmp(&tuplas[valores[h] * k], t, k * sizeof(int)) != 0 ) {
+                h = (h + 1) & (tam_tabla - 1);
+            }
+            if ( !valores[h] ) {
+                if ( n >= MAX_NUM_ESTADOS ) {
+                    panico("El producto tiene demasiados estados.");
+                }
+                valores[h] = n;
+                memcpy(&tuplas[n * k], t, k * sizeof(int));
+                ++n;
+            }
+            res->tabla[q][c] = (estado_t)valores[h];
+        }
+    }
+    arena_pop(&hijo);
+
+    res->num_estados = n;
+    af_cerrar(res, temp);
+}
+
+// Carga y minimiza los componentes de un producto, y construye el producto.
+static void cargar_producto(AF* res, char** paths, int num_paths, int op, Arena* temp)
+{
+    static char* nombres[] = { "interseccion", "union", "diferencia", "patrones" };
+    if ( num_paths < 2 || num_paths > MAX_COMPONENTES ) {
+        panico("El producto necesita entre 2 y 31 automatas.");
+    }
+    Componente* comps = (Componente*)sgl_calloc(num_paths, sizeof(Componente));
+
+    sgl_log("\n\n***** %s de", nombres[op]);
+    double posibles = 1;
+    for ( int i = 0; i < num_paths; ++i ) {
+        if ( !cargar_af(&comps[i].af, paths[i], temp) ) {
+            panico("No se pudieron leer los automatas");
+        }
+        if ( comps[i].af.num_intervalos ) {
+            panico("El producto todavia no acepta automatas con rangos.");
+        }
+        minimizar(&comps[i].af, &comps[i].min, temp);
+        comps[i].sumidero = clase_sumidero(&comps[i].af, &comps[i].min);
+        posibles *= comps[i].min.num_clases;
+        sgl_log(" %s", paths[i]);
+    }
+    sgl_log(" *****\n");
+
+    construir_producto(res, comps, num_paths, op, temp);
+    sgl_log("Producto con %d estados (de %.0f tuplas de clases posibles)\n", res->num_estados - 1, posibles);
+}
+
+static void procesar_producto(char** paths, int num_paths, int op)
+{
+    static AF res;
+    static Minimizado min;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+    cargar_producto(&res, paths, num_paths, op, &temp);
+    minimizar(&res, &min, &temp);
+    reportar(op == PRODUCTO_inter ? "interseccion" : op == PRODUCTO_union ? "union" : "diferencia", &res, &min);
+}
+
+static void imprimir_patrones(char** paths, int num_paths, uint32_t aceptan)
+{
+    for ( int i = 0; i < num_paths; ++i ) {
+        if ( aceptan & ((uint32_t)1 << i) ) {
+            sgl_log(" %s", paths[i]);
+        }
+    }
+    sgl_log("\n");
+}
+
+// Union etiquetada de los automatas. Si hay archivo de entrada, cada linea se
+// ejecuta una vez en el automata minimizado y se reportan todos los patrones
+// que la aceptan.
+static void procesar_patrones(char** paths, int num_paths, char* path_entrada)
+{
+    static AF res;
+    static Minimizado min;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+    cargar_producto(&res, paths, num_paths, PRODUCTO_etiquetas, &temp);
+    minimizar(&res, &min, &temp);
+    reportar("patrones", &res, &min);
+
+    sgl_log("Patrones de cada estado final:\n");
+    for ( int ci = 0; ci < min.num_clases; ++ci ) {
+        int p = min.representante[ci];
+        if ( res.finales[p] ) {
+            sgl_log("q%d:", ci);
+            imprimir_patrones(paths, num_paths, (uint32_t)res.finales[p]);
+        }
+    }
+
+    if ( path_entrada ) {
+        TablaMin t;
+        tabla_min_construir(&t, &res, &min, &temp);
+        char ventana[TAM_VENTANA];
+        SglLineReader lector;
+        if ( sgl_line_reader_open(&lector, path_entrada, ventana, TAM_VENTANA) != 0 ) {
+            panico("No se pudo leer el archivo de entrada");
+        }
+        char* linea;
+        while ( (linea = sgl_line_reader_next(&lector)) != NULL ) {
+            uint32_t aceptan = tabla_min_ejecutar(&t, linea, strlen(linea));
+            if ( aceptan ) {
+                sgl_log("Linea %d:", lector.line_number);
+                imprimir_patrones(paths, num_paths, aceptan);
+            }
+        }
+        if ( lector.error ) {
+            panico("Hay una linea demasiado larga en el archivo de entrada.");
+        }
+        sgl_line_reader_close(&lector);
+    }
+}
+
+// ==== Minimizacion en memoria externa
+//
+// Para automatas que no caben en memoria (ni en la tabla de MAX_NUM_ESTADOS).
+// Todo lo que es proporcional al numero de estados vive en archivos
+// temporales mapeados con mmap, que el sistema puede sacar de memoria cuando
+// le haga falta:
+//  - delta: n * ns estados de 32 bits, la tabla de transiciones.
+//  - marcas: un byte por estado (MARCA_final, MARCA_alcanzable).
+//  - clase, cola, numero: 32 bits por estado.
+// El csv se lee dos veces con la misma ventana que cargar_af: la primera para
+// saber cuantos estados y simbolos hay, y la segunda para llenar delta.
+//
+// La particion se refina con Moore, en pasadas secuenciales. En cada pasada
+// se escribe para cada estado alcanzable el registro (clase, clase de cada
+// sucesor, estado). Los registros se ordenan por firma (todo menos el estado)
+// con un ordenamiento externo: corridas ordenadas del tamaño del presupuesto
+// de memoria, y luego una mezcla de todas las corridas. Las clases nuevas son
+// las firmas distintas, en el orden en que salen. Como la firma incluye la
+// clase anterior la particion solo se refina, asi que cuando una pasada no
+// crea clases ya es estable.
+//
+// El presupuesto (--memoria) limita la memoria propia del programa: las
+// corridas y los buffers de la mezcla. Las paginas de los archivos mapeados
+// son cache del sistema.
+//
+// El resultado se escribe como csv, con las clases numeradas en el orden en
+// que se encuentran desde el estado inicial (que es 1) y sin el estado error.
+
+#if defined(__linux__) || defined(__MACH__)
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define MEMORIA_EXTERNA (256 * 1024 * 1024)
+
+enum {
+    MARCA_final = 1,
+    MARCA_alcanzable = 2
+};
+
+typedef struct Mapa_s {
+    void*   datos;
+    size_t  tam;
+} Mapa;
+
+typedef struct Externo_s {
+    char*       dir;            // Donde van los archivos temporales.
+    size_t      memoria;        // Presupuesto en bytes.
+    int         temporales;     // Para nombrar los archivos temporales.
+
+    uint32_t    num_estados;
+    int         num_simbolos;
+    char        en_alfabeto[NUM_ASCII_CHARS];
+    char        alfabeto[NUM_ASCII_CHARS];
+    int         columna[NUM_ASCII_CHARS];
+
+    Mapa        mapa_delta;
+    Mapa        mapa_marcas;
+    Mapa        mapa_clase;
+    Mapa        mapa_cola;
+    Mapa        mapa_numero;
+    uint32_t*   delta;          // delta[q * num_simbolos + ai]
+    uint8_t*    marcas;
+    uint32_t*   clase;
+    uint32_t*   cola;           // Los alcanzables en el orden del BFS.
+    uint32_t*   numero;         // Numero de cada clase en la salida, 0 si no tiene.
+    uint32_t    num_alcanzables;
+    uint32_t    num_clases;
+    int         num_corridas;   // Por pasada, en la ultima minimizacion.
+    size_t      usada;          // Bytes mapeados y de corridas en la ultima minimizacion.
+} Externo;
+
+// Abre un archivo temporal nuevo en e->dir y lo borra del directorio, asi que
+// desaparece solo al cerrarlo.
+static int ext_temporal(Externo* e)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/.p01-%d-%d", e->dir, (int)getpid(), e->temporales++);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if ( fd < 0 ) {
+        panico("No se pudo crear un archivo temporal");
+    }
+    unlink(path);
+    return fd;
+}
+
+static void* ext_mapear(Externo* e, Mapa* m, size_t tam)
+{
+    int fd = ext_temporal(e);
+    m->tam = tam ? tam : 1;
+    // Crecer el archivo escribiendo el ultimo byte. El resto queda en ceros.
+    if ( lseek(fd, (off_t)(m->tam - 1), SEEK_SET) < 0 || write(fd, "", 1) != 1 ) {
+        panico("No se pudo crecer un archivo temporal");
+    }
+    m->datos = mmap(NULL, m->tam, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( m->datos == MAP_FAILED ) {
+        panico("No se pudo mapear un archivo temporal");
+    }
+    return m->datos;
+}
+
+static void ext_desmapear(Mapa* m)
+{
+    if ( m->datos ) {
+        munmap(m->datos, m->tam);
+        m->datos = NULL;
+    }
+}
+
+static FILE* ext_corrida(Externo* e)
+{
+    FILE* f = fdopen(ext_temporal(e), "w+b");
+    if ( !f ) {
+        panico("No se pudo abrir una corrida");
+    }
+    return f;
+}
+
+// Como interpretar_linea, pero sin limite de estados. En la pasada 0 solo
+// cuenta estados y simbolos; en la 1 llena delta y los finales.
+static void ext_interpretar(Externo* e, char* linea, int pasada, int es_primera)
+{
+    int parse_state = PARSE_estado;
+    uint32_t estado = 0;
+    int entrada_actual = 0;
+    char* iter = linea;
+    char* tok;
+    while ( (tok = sgl_tokenize_inplace(&iter, ',')) != NULL ) {
+        tok = sgl_strip_whitespace_inplace(tok);
+
+        switch (parse_state) {
+        case PARSE_estado: {
+            long long v = atoll(tok);
+            if ( !sgl_is_number(tok) || v <= 0 || v >= UINT32_MAX ) {
+                panico("Estado invalido\n");
+            }
+            if ( es_primera && v != 1 ) {
+                panico("El primer estado tiene que ser 1");
+            }
+            estado = (uint32_t)v;
+            if ( pasada == 0 && estado >= e->num_estados ) {
+                e->num_estados = estado + 1;
+            }
+            parse_state = PARSE_entrada;
+            break;
+        }
+        case PARSE_entrada: {
+            if ( sgl_is_number(tok) ) {
+                int final = atoi(tok);
+                if ( final != 0 && final != 1 ) {
+                    panico("Definicion de final tiene que ser 0 o 1.");
+                }
+                if ( pasada == 1 && final ) {
+                    e->marcas[estado] |= MARCA_final;
+                }
+                parse_state = PARSE_final;
+            } else if ( strlen(tok) == 1 && (unsigned char)tok[0] < NUM_ASCII_CHARS ) {
+                entrada_actual = (unsigned char)tok[0];
+                e->en_alfabeto[entrada_actual] = 1;
+                parse_state = PARSE_trans;
+            } else {
+                panico("El modo externo solo acepta automatas deterministas con entradas ascii.");
+            }
+            break;
+        }
+        case PARSE_trans: {
+            long long v = atoll(tok);
+            if ( !sgl_is_number(tok) || v >= UINT32_MAX ) {
+                panico("Las transiciones deben ser numeros positivos (estados).");
+            }
+            if ( v > 0 ) {
+                if ( pasada == 0 && v >= e->num_estados ) {
+                    e->num_estados = (uint32_t)v + 1;
+                }
+                if ( pasada == 1 ) {
+                    uint32_t* d = &e->delta[(size_t)estado * e->num_simbolos + e->columna[entrada_actual]];
+                    if ( *d && *d != (uint32_t)v ) {
+                        panico("El modo externo solo acepta automatas deterministas.");
+                    }
+                    *d = (uint32_t)v;
+                }
+            }
+            parse_state = PARSE_entrada;
+            break;
+        }
+        case PARSE_final: {
+            panico("Mas datos en el archivo de los esperados");
+            break;
+        }
+        }
+    }
+}
+
+static void ext_leer(Externo* e, char* path, int pasada)
+{
+    char ventana[TAM_VENTANA];
+    SglLineReader lector;
+    if ( sgl_line_reader_open(&lector, path, ventana, TAM_VENTANA) != 0 ) {
+        panico("No se pudo leer el automata");
+    }
+    int es_primera = 1;
+    char* linea;
+    while ( (linea = sgl_line_reader_next(&lector)) != NULL ) {
+        if ( linea[0] == '#' || *sgl_strip_whitespace_inplace(linea) == '\0' ) {
+            continue;
+        }
+        ext_interpretar(e, linea, pasada, es_primera);
+        es_primera = 0;
+    }
+    if ( lector.error ) {
+        panico("Hay una linea demasiado larga en el archivo.");
+    }
+    sgl_line_reader_close(&lector);
+}
+
+// BFS desde el estado 1. El estado error se marca aunque no se alcance, para
+// que los estados muertos queden en su clase.
+static void ext_alcanzables(Externo* e)
+{
+    int ns = e->num_simbolos;
+    uint32_t fin = 0;
+    e->cola[fin++] = 1;
+    e->marcas[1] |= MARCA_alcanzable;
+    for ( uint32_t i = 0; i < fin; ++i ) {
+        uint32_t q = e->cola[i];
+        for ( int ai = 0; ai < ns; ++ai ) {
+            uint32_t p = e->delta[(size_t)q * ns + ai];
+            if ( !(e->marcas[p] & MARCA_alcanzable) ) {
+                e->marcas[p] |= MARCA_alcanzable;
+                e->cola[fin++] = p;
+            }
+        }
+    }
+    e->marcas[0] |= MARCA_alcanzable;
+    e->num_alcanzables = fin;
+}
+
+static size_t g_tam_firma;  // Para comparar_registros, que no recibe contexto.
+
+// Cualquier orden total sirve: solo importa que las firmas iguales queden
+// juntas.
+static int comparar_registros(const void* a, const void* b)
+{
+    return memcmp(a, b, g_tam_firma);
+}
+
+// Una pasada de Moore. Regresa el numero de clases nuevo.
+static uint32_t ext_refinar(Externo* e, uint32_t* registros, size_t por_corrida, int* num_corridas)
+{
+    int ns = e->num_simbolos;
+    size_t palabras = (size_t)ns + 2;
+    size_t tam = palabras * sizeof(uint32_t);
+    g_tam_firma = tam - sizeof(uint32_t);
+
+    // Corridas ordenadas.
+    FILE** corridas = NULL;
+    size_t llenos = 0;
+    for ( uint32_t q = 0; q < e->num_estados; ++q ) {
+        if ( !(e->marcas[q] & MARCA_alcanzable) ) {
+            continue;
+        }
+        uint32_t* r = &registros[llenos * palabras];
+        r[0] = e->clase[q];
+        for ( int ai = 0; ai < ns; ++ai ) {
+            r[1 + ai] = e->clase[e->delta[(size_t)q * ns + ai]];
+        }
+        r[palabras - 1] = q;
+        if ( ++llenos == por_corrida ) {
+            qsort(registros, llenos, tam, comparar_registros);
+            FILE* f = ext_corrida(e);
+            if ( fwrite(registros, tam, llenos, f) != llenos ) {
+                panico("No se pudo escribir una corrida");
+            }
+            sb_push(corridas, f);
+            llenos = 0;
+        }
+    }
+    qsort(registros, llenos, tam, comparar_registros);
+
+    // Numerar las firmas distintas. Si todo cupo en una corrida, se recorre
+    // en memoria; si no, se mezclan las corridas (y lo que quedo en memoria
+    // es una corrida mas) escogiendo cada vez la cabeza menor.
+    uint32_t num_clases = 0;
+    uint32_t* anterior = (uint32_t*)malloc(tam);
+    int k = sb_count(corridas);
+    *num_corridas = k + (llenos > 0);
+    if ( !anterior ) {
+        panico("No hay memoria para refinar");
+    }
+    if ( k == 0 ) {
+        for ( size_t i = 0; i < llenos; ++i ) {
+            uint32_t* r = &registros[i * palabras];
+            if ( !num_clases || memcmp(anterior, r, g_tam_firma) != 0 ) {
+                memcpy(anterior, r, tam);
+                ++num_clases;
+            }
+            e->clase[r[palabras - 1]] = num_clases - 1;
+        }
+    } else {
+        uint32_t* cabezas = (uint32_t*)malloc((k + 1) * tam);
+        int* vivas = (int*)malloc((k + 1) * sizeof(int));
+        size_t en_memoria = 0;
+        if ( !cabezas || !vivas ) {
+            panico("No hay memoria para mezclar las corridas");
+        }
+        for ( int i = 0; i < k; ++i ) {
+            rewind(corridas[i]);
+            vivas[i] = fread(&cabezas[i * palabras], tam, 1, corridas[i]) == 1;
+        }
+        vivas[k] = llenos > 0;
+        if ( vivas[k] ) {
+            memcpy(&cabezas[k * palabras], registros, tam);
+        }
+        for (;;) {
+            int menor = -1;
+            for ( int i = 0; i <= k; ++i ) {
+                if ( vivas[i] && (menor < 0 ||
+                     comparar_registros(&cabezas[i * palabras], &cabezas[menor * palabras]) < 0) ) {
+                    menor = i;
+                }
+            }
+            if ( menor < 0 ) {
+                break;
+            }
+            uint32_t* r = &cabezas[menor * palabras];
+            if ( !num_clases || memcmp(anterior, r, g_tam_firma) != 0 ) {
+                memcpy(anterior, r, tam);
+                ++num_clases;
+            }
+            e->clase[r[palabras - 1]] = num_clases - 1;
+            if ( menor < k ) {
+                vivas[menor] = fread(r, tam, 1, corridas[menor]) == 1;
+            } else if ( ++en_memoria < llenos ) {
+                memcpy(r, &registros[en_memoria * palabras], tam);
+            } else {
+                vivas[k] = 0;
+            }
+        }
+        for ( int i = 0; i < k; ++i ) {
+            fclose(corridas[i]);
+        }
+        free(cabezas);
+        free(vivas);
+    }
+    free(anterior);
+    if ( corridas ) {
+        free(sgl__sbraw(corridas));
+    }
+    return num_clases;
+}
+
+static void ext_escribir(Externo* e, char* path)
+{
+    FILE* fd = fopen(path, "w");
+    if ( !fd ) {
+        panico("No se pudo escribir el resultado");
+    }
+    int ns = e->num_simbolos;
+    uint32_t error = e->clase[0];
+
+    // Numerar las clases en el orden del BFS.
+    uint32_t num = 0;
+    for ( uint32_t i = 0; i < e->num_alcanzables; ++i ) {
+        uint32_t c = e->clase[e->cola[i]];
+        if ( c != error && !e->numero[c] ) {
+            e->numero[c] = ++num;
+        }
+    }
+    if ( !num ) {
+        fprintf(fd, "1, 0\n");  // Lenguaje vacio.
+    }
+    // Una linea por clase, con el primer estado de la clase que aparece.
+    uint32_t escritas = 0;
+    for ( uint32_t i = 0; i < e->num_alcanzables; ++i ) {
+        uint32_t q = e->cola[i];
+        uint32_t c = e->clase[q];
+        if ( c == error || e->numero[c] != escritas + 1 ) {
+            continue;
+        }
+        ++escritas;
+        fprintf(fd, "%" PRIu32, e->numero[c]);
+        for ( int ai = 0; ai < ns; ++ai ) {
+            uint32_t d = e->clase[e->delta[(size_t)q * ns + ai]];
+            if ( d != error ) {
+                fprintf(fd, ", %c, %" PRIu32, e->alfabeto[ai], e->numero[d]);
+            }
+        }
+        fprintf(fd, ", %d\n", e->marcas[q] & MARCA_final);
+    }
+    if ( fclose(fd) != 0 ) {
+        panico("No se pudo escribir el resultado");
+    }
+    e->num_clases = num;
+}
+
+// Minimiza el automata de path y escribe el resultado en path_salida. Regresa
+// el numero de pasadas.
+static int ext_minimizar(Externo* e, char* path, char* path_salida, char* dir, size_t memoria)
+{
+    memset(e, 0, sizeof(Externo));
+    e->dir = dir;
+    e->memoria = memoria;
+    e->num_estados = 2;
+
+    ext_leer(e, path, 0);
+    for ( int c = 0; c < NUM_ASCII_CHARS; ++c ) {
+        if ( e->en_alfabeto[c] ) {
+            e->columna[c] = e->num_simbolos;
+            e->alfabeto[e->num_simbolos++] = (char)c;
+        }
+    }
+    size_t n = e->num_estados;
+    e->delta = (uint32_t*)ext_mapear(e, &e->mapa_delta, n * e->num_simbolos * sizeof(uint32_t));
+    e->marcas = (uint8_t*)ext_mapear(e, &e->mapa_marcas, n);
+    ext_leer(e, path, 1);
+
+    e->cola = (uint32_t*)ext_mapear(e, &e->mapa_cola, n * sizeof(uint32_t));
+    ext_alcanzables(e);
+
+    // Particion inicial: finales y no finales.
+    e->clase = (uint32_t*)ext_mapear(e, &e->mapa_clase, n * sizeof(uint32_t));
+    int hay[2] = { 0 };
+    for ( size_t q = 0; q < n; ++q ) {
+        if ( e->marcas[q] & MARCA_alcanzable ) {
+            e->clase[q] = e->marcas[q] & MARCA_final;
+            hay[e->clase[q]] = 1;
+        }
+    }
+    uint32_t num_clases = hay[0] + hay[1];
+
+    size_t tam_registro = (e->num_simbolos + 2) * sizeof(uint32_t);
+    size_t por_corrida = max(memoria / tam_registro, 1);
+    if ( por_corrida > (size_t)e->num_alcanzables + 1 ) {
+        por_corrida = (size_t)e->num_alcanzables + 1;
+    }
+    uint32_t* registros = (uint32_t*)malloc(por_corrida * tam_registro);
+    if ( !registros ) {
+        panico("No hay memoria para las corridas");
+    }
+    int pasadas = 0;
+    e->num_corridas = 0;
+    for (;;) {
+        ++pasadas;
+        uint32_t nuevas = ext_refinar(e, registros, por_corrida, &e->num_corridas);
+        if ( nuevas == num_clases ) {
+            break;
+        }
+        num_clases = nuevas;
+    }
+    e->usada = por_corrida * tam_registro + e->mapa_delta.tam + e->mapa_marcas.tam + e->mapa_cola.tam +
+               e->mapa_clase.tam;
+    free(registros);
+
+    e->numero = (uint32_t*)ext_mapear(e, &e->mapa_numero, n * sizeof(uint32_t));
+    e->usada += e->mapa_numero.tam;
+    ext_escribir(e, path_salida);
+
+    ext_desmapear(&e->mapa_delta);
+    ext_desmapear(&e->mapa_marcas);
+    ext_desmapear(&e->mapa_cola);
+    ext_desmapear(&e->mapa_clase);
+    ext_desmapear(&e->mapa_numero);
+    return pasadas;
+}
+
+static void procesar_externo(char* path, char* path_salida, char* dir, size_t memoria)
+{
+    static Externo e;
+    int pasadas = ext_minimizar(&e, path, path_salida, dir, memoria);
+    sgl_log("%s: %" PRIu32 " estados, %" PRIu32 " alcanzables\n", path, e.num_estados - 1, e.num_alcanzables);
+    sgl_log("%" PRIu32 " estados minimizados (sin el error) en %d pasadas, %d corridas por pasada\n",
+            e.num_clases, pasadas, e.num_corridas);
+    sgl_log("Resultado en %s\n", path_salida);
+}
+
+#else  // Sin mmap en otras plataformas.
+
+#define MEMORIA_EXTERNA 0
+
+static void procesar_externo(char* path, char* path_salida, char* dir, size_t memoria)
+{
+    panico("La minimizacion externa solo esta disponible en Linux y macOS.");
+}
+
+#endif
+
+// ==== Pipeline
+//
+// Cuatro etapas, cada una en su hilo: lector -> interprete -> minimizador ->
+// salida. Se comunican con colas; un numero fijo de trabajos circula entre
+// ellas, asi que a lo mas NUM_TRABAJOS automatas estan en memoria a la vez y
+// el lector no se adelanta mas que eso.
+//
+// El lector no carga archivos completos: le pasa al interprete pedazos de
+// TAM_VENTANA bytes por su propia cola, con NUM_TROZOS pedazos circulando, y
+// el interprete los va interpretando con un LectorAF. Asi la latencia de IO
+// queda detras de la minimizacion del archivo anterior sin que la memoria
+// dependa del tamaño de los archivos.
+
+#define NUM_TRABAJOS 4
+#define NUM_TROZOS   8
+
+typedef struct Trabajo_s {
+    char*   path;
+    int     leido;
+    AF      af;
+    Minimizado min;
+
+    // Solo para el servidor.
+    char*       contenido;  // La peticion, terminada en 0.
+    size_t      capacidad;
+    uint32_t    id;
+    size_t      largo;      // Bytes de la peticion en `contenido`.
+    int64_t     inicio;     // Cuando se termino de leer, en microsegundos.
+    char*       respuesta;  // (stretchy buffer)
+} Trabajo;
+
+// Guarda trabajos o trozos.
+typedef struct Cola_s {
+    void*           elementos[NUM_TROZOS + 1];  // + 1 para el fin.
+    int             inicio;
+    int             cuenta;
+    SglSemaphore*   llenos;
+    SglMutex*       mutex;
+} Cola;
+
+static void cola_iniciar(Cola* cola)
+{
+    memset(cola, 0, sizeof(Cola));
+    cola->llenos = sgl_create_semaphore(0);
+    cola->mutex = sgl_create_mutex();
+    if ( !cola->llenos || !cola->mutex ) {
+        panico("No se pudo crear una cola");
+    }
+}
+
+// Nunca se bloquea: no hay mas trabajos ni trozos que lugares en la cola.
+static void cola_meter(Cola* cola, void* t)
+{
+    sgl_mutex_lock(cola->mutex);
+    assert(cola->cuenta < (int)sgl_array_count(cola->elementos));
+    int i = (cola->inicio + cola->cuenta) % sgl_array_count(cola->elementos);
+    cola->elementos[i] = t;
+    cola->cuenta++;
+    sgl_mutex_unlock(cola->mutex);
+    sgl_semaphore_signal(cola->llenos);
+}
+
+static void* cola_sacar(Cola* cola)
+{
+    sgl_semaphore_wait(cola->llenos);
+    sgl_mutex_lock(cola->mutex);
+    void* t = cola->elementos[cola->inicio];
+    cola->inicio = (cola->inicio + 1) % sgl_array_count(cola->elementos);
+    cola->cuenta--;
+    sgl_mutex_unlock(cola->mutex);
+    return t;
+}
+
+// Un pedazo de un archivo, en orden. El ultimo de cada archivo viene vacio.
+typedef struct Trozo_s {
+    Trabajo*    trabajo;
+    size_t      largo;
+    char        datos[TAM_VENTANA];
+} Trozo;
+
+typedef struct Pipeline_s {
+    char**          paths;
+    int             num_paths;
+    Trabajo         trabajos[NUM_TRABAJOS];
+    Trozo           trozos[NUM_TROZOS];
+    LectorAF        lector;     // Del interprete.
+    Cola            libres;
+    Cola            trozos_libres;
+    Cola            por_interpretar;    // De trozos.
+    Cola            por_minimizar;
+    Cola            por_imprimir;
+    Arena           arena_interprete;
+    Arena           arena_minimizador;
+} Pipeline;
+
+// Un NULL en la cola indica que no hay mas archivos.
+static void etapa_lector(void* param)
+{
+    Pipeline* pl = (Pipeline*)param;
+    for ( int i = 0; i < pl->num_paths; ++i ) {
+        Trabajo* t = cola_sacar(&pl->libres);
+        t->path = pl->paths[i];
+        FILE* fd = fopen(t->path, "rb");
+        t->leido = fd != NULL;
+        if ( !fd ) {
+            fprintf(stderr, "ERROR: couldn't open %s\n", t->path);
+        }
+        Trozo* z;
+        do {
+            z = cola_sacar(&pl->trozos_libres);
+            z->trabajo = t;
+            z->largo = fd ? fread(z->datos, 1, TAM_VENTANA, fd) : 0;
+            cola_meter(&pl->por_interpretar, z);
+        } while ( z->largo );
+        if ( fd ) {
+            fclose(fd);
+        }
+    }
+    cola_meter(&pl->por_interpretar, NULL);
+}
+
+// Un archivo termina con su trozo vacio. Hasta entonces su automata se queda
+// en el interprete.
+static void etapa_interprete(void* param)
+{
+    Pipeline* pl = (Pipeline*)param;
+    Trozo* z;
+    Trabajo* actual = NULL;
+    while ( (z = cola_sacar(&pl->por_interpretar)) != NULL ) {
+        Trabajo* t = z->trabajo;
+        size_t largo = z->largo;
+        if ( t->leido ) {
+            if ( t != actual ) {
+                medir_inicio(ETAPA_lectura);
+                lector_af_iniciar(&pl->lector, &t->af);
+                actual = t;
+            }
+            lector_af_agregar(&pl->lector, z->datos, largo);
+        }
+        cola_meter(&pl->trozos_libres, z);
+        if ( !largo ) {
+            if ( t->leido ) {
+                lector_af_terminar(&pl->lector, &pl->arena_interprete);
+                medir_fin(ETAPA_lectura);
+            }
+            actual = NULL;
+            cola_meter(&pl->por_minimizar, t);
+        }
+    }
+    cola_meter(&pl->por_minimizar, NULL);
+}
+
+static void etapa_minimizador(void* param)
+{
+    Pipeline* pl = (Pipeline*)param;
+    Trabajo* t;
+    while ( (t = cola_sacar(&pl->por_minimizar)) != NULL ) {
+        if ( t->leido ) {
+            minimizar_con_cache(&t->af, &t->min, &pl->arena_minimizador);
+        }
+        cola_meter(&pl->por_imprimir, t);
+    }
+    cola_meter(&pl->por_imprimir, NULL);
+}
+
+static void etapa_salida(void* param)
+{
+    Pipeline* pl = (Pipeline*)param;
+    Trabajo* t;
+    while ( (t = cola_sacar(&pl->por_imprimir)) != NULL ) {
+        sgl_log("\n\n***** Procesando archivo %s *****\n", t->path);
+        if ( t->leido ) {
+            medir_inicio(ETAPA_salida);
+            reportar(t->path, &t->af, &t->min);
+            medir_fin(ETAPA_salida);
+        }
+        cola_meter(&pl->libres, t);
+    }
+}
+
+static void procesar_pipeline(char** paths, int num_paths)
+{
+    static Pipeline pl;
+    pl.paths = paths;
+    pl.num_paths = num_paths;
+    cola_iniciar(&pl.libres);
+    cola_iniciar(&pl.trozos_libres);
+    cola_iniciar(&pl.por_interpretar);
+    cola_iniciar(&pl.por_minimizar);
+    cola_iniciar(&pl.por_imprimir);
+    for ( int i = 0; i < NUM_TRABAJOS; ++i ) {
+        cola_meter(&pl.libres, &pl.trabajos[i]);
+    }
+    for ( int i = 0; i < NUM_TROZOS; ++i ) {
+        cola_meter(&pl.trozos_libres, &pl.trozos[i]);
+    }
+    pl.arena_interprete = crear_arena(TAM_ARENA_HILO);
+    pl.arena_minimizador = crear_arena(TAM_ARENA_HILO);
+
+    SglThread* etapas[] = {
+        sgl_create_thread(etapa_lector, &pl),
+        sgl_create_thread(etapa_interprete, &pl),
+        sgl_create_thread(etapa_minimizador, &pl),
+        sgl_create_thread(etapa_salida, &pl),
+    };
+    // Cada etapa termina despues de pasar el fin a la siguiente.
+    for ( int i = 0; i < (int)sgl_array_count(etapas); ++i ) {
+        sgl_join_thread(etapas[i]);
+    }
+}
+
+static void procesar_expresiones(char** expresiones, int num_expresiones)
+{
+    static AF af;
+    static Minimizado min;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+
+    for ( int i = 0; i < num_expresiones; ++i ) {
+        sgl_log("\n\n***** Procesando expresion %s *****\n", expresiones[i]);
+        medir_inicio(ETAPA_lectura);
+        int num_terminos = cargar_af_de_regex(&af, expresiones[i], &temp);
+        medir_fin(ETAPA_lectura);
+        sgl_log("%d estados (derivadas distintas), %d terminos\n", af.num_estados - 1, num_terminos);
+        minimizar_con_cache(&af, &min, &temp);
+        medir_inicio(ETAPA_salida);
+        reportar(expresiones[i], &af, &min);
+        medir_fin(ETAPA_salida);
+    }
+}
+
+// Procesa los archivos uno por uno, en el hilo principal.
+static void procesar_secuencial(char** paths, int num_paths)
+{
+    static AF af;
+    static Minimizado min;
+    Arena temp = crear_arena(TAM_ARENA_HILO);
+
+    for (int32_t i = 0; i < num_paths; ++i) {
+        // -- Nuevo archivo:
+        sgl_log("\n\n***** Procesando archivo %s *****\n", paths[i]);
+
+        medir_inicio(ETAPA_lectura);
+        int leido = cargar_af(&af, paths[i], &temp);
+        medir_fin(ETAPA_lectura);
+        if ( !leido ) {
+            continue;
+        }
+        minimizar_con_cache(&af, &min, &temp);
+        medir_inicio(ETAPA_salida);
+        reportar(paths[i], &af, &min);
+        medir_fin(ETAPA_salida);
+    }
+}
+
+// ==== Servidor
+//
+// Un proceso que se queda vivo y minimiza los automatas que le mandan, para
+// no pagar el arranque (ni mem_init) en cada archivo. Lee peticiones de la
+// entrada estandar, o de las conexiones a un socket Unix, y contesta en el
+// mismo canal.
+//
+// Cada peticion es un marco: id (uint32), largo (uint32) y `largo` bytes con
+// el automata, en csv o en binario (ver cargar_af_binario). Los enteros van en
+// little endian. La respuesta es otro marco con el mismo id y un texto que
+// empieza con "ok MICROSEGUNDOS\n" seguido del resultado como lo imprime p01,
+// o con "error MENSAJE\n".
+//
+// El lector (el hilo principal) no espera respuestas antes de leer la
+// siguiente peticion: las reparte entre NUM_TRABAJOS hilos, cada uno con su
+// arena, y cada uno escribe su respuesta cuando termina. Las respuestas
+// pueden llegar en otro orden que las peticiones; para eso es el id. Hay a lo
+// mas NUM_TRABAJOS peticiones en vuelo, como en el pipeline.
+//
+// Si el automata tiene un error, panico() regresa al trabajador con longjmp
+// en lugar de terminar el proceso, y se contesta con el mensaje.
+//
+// Si el cliente cierra la conexion antes de recibir sus respuestas, escribir
+// falla con EPIPE o ECONNRESET (SIGPIPE se ignora para que no mate al
+// proceso). Eso termina la conexion: no se leen mas marcos, los que estaban
+// en la cola se descartan sin minimizarlos y se regresa a accept().
+//
+// SIGTERM y SIGINT los recibe el hilo principal (los trabajadores los tienen
+// bloqueados). El manejador escribe un byte en un pipe y el hilo principal
+// espera con poll() a la vez la entrada y ese pipe antes de cada read() y
+// accept(), asi que una senal que llega justo antes de esperar no se pierde.
+// Se contestan las peticiones que ya se leyeron, se borra el socket y se
+// imprimen las latencias.
+
+#if defined(__linux__) || defined(__MACH__)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define MAX_MARCO (16 * 1024 * 1024)
+
+typedef struct Servidor_s {
+    Trabajo         trabajos[NUM_TRABAJOS];
+    Cola            libres;
+    Cola            pendientes;
+    Arena           arenas[NUM_TRABAJOS];
+    int             salida;         // fd donde se escriben las respuestas.
+    int             cortada;        // El cliente se fue: ya no se contesta.
+    SglMutex*       mutex_salida;   // Tambien protege `cortada` y las estadisticas.
+    int64_t         num_peticiones;
+    int64_t         latencia_total;
+    int64_t         latencia_max;
+} Servidor;
+
+typedef struct Trabajador_s {
+    Servidor*   sv;
+    Arena*      arena;
+} Trabajador;
+
+static volatile sig_atomic_t g_parar_servidor;
+static int g_pipe_senal[2] = { -1, -1 };  // El byte nunca se saca: una vez que llega, poll() siempre lo ve.
+
+static void servidor_senal(int senal)
+{
+    (void)senal;
+    int error = errno;
+    g_parar_servidor = 1;
+    if ( write(g_pipe_senal[1], "", 1) < 0 ) {
+        // El pipe esta lleno: ya hay un byte.
+    }
+    errno = error;
+}
+
+// Espera a que se pueda leer fd. Regresa 0 si antes llego SIGTERM o SIGINT.
+static int esperar_entrada(int fd)
+{
+    struct pollfd espera[2] = {
+        { .fd = fd, .events = POLLIN },
+        { .fd = g_pipe_senal[0], .events = POLLIN },
+    };
+    for (;;) {
+        if ( g_parar_servidor ) {
+            return 0;
+        }
+        if ( poll(espera, 2, -1) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            return 0;
+        }
+        if ( espera[1].revents ) {
+            return 0;
+        }
+        if ( espera[0].revents ) {
+            return 1;
+        }
+    }
+}
+
+static int servidor_cortada(Servidor* sv)
+{
+    sgl_mutex_lock(sv->mutex_salida);
+    int cortada = sv->cortada;
+    sgl_mutex_unlock(sv->mutex_salida);
+    return cortada;
+}
+
+static uint32_t leer_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void escribir_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Regresa 0 si se acaba la entrada antes de leer n bytes, o si llega una senal.
+static int leer_exacto(int fd, void* datos, size_t n)
+{
+    uint8_t* p = (uint8_t*)datos;
+    while ( n ) {
+        if ( !esperar_entrada(fd) ) {
+            return 0;
+        }
+        ssize_t leidos = read(fd, p, n);
+        if ( leidos <= 0 ) {
+            return 0;
+        }
+        p += leidos;
+        n -= (size_t)leidos;
+    }
+    return 1;
+}
+
+static int escribir_exacto(int fd, const void* datos, size_t n)
+{
+    const uint8_t* p = (const uint8_t*)datos;
+    while ( n ) {
+        ssize_t escritos = write(fd, p, n);
+        if ( escritos <= 0 ) {
+            return 0;
+        }
+        p += escritos;
+        n -= (size_t)escritos;
+    }
+    return 1;
+}
+
+// Formato binario: "P01B", n (uint32), ns (uint32), los ns simbolos (un byte
+// cada uno, sin repetir), n bytes de finales y n * ns destinos (uint32), fila
+// por fila. El estado 0 es el estado error y el 1 el inicial, como en el csv.
+static void cargar_af_binario(AF* af, const uint8_t* datos, size_t tam, Arena* temp)
+{
+    if ( tam < 12 ) {
+        panico("Marco binario incompleto");
+    }
+    uint32_t n = leer_u32(datos + 4);
+    uint32_t ns = leer_u32(datos + 8);
+    if ( n < 2 || n > MAX_NUM_ESTADOS || ns > NUM_ASCII_CHARS ) {
+        panico("Automata binario demasiado grande");
+    }
+    if ( tam != 12 + ns + n + 4 * (size_t)n * ns ) {
+        panico("El tamaño del marco binario no corresponde al automata");
+    }
+    af_iniciar(af);
+    const uint8_t* simbolos = datos + 12;
+    const uint8_t* finales = simbolos + ns;
+    const uint8_t* destinos = finales + n;
+    for ( uint32_t ai = 0; ai < ns; ++ai ) {
+        if ( simbolos[ai] >= NUM_ASCII_CHARS ) {
+            panico("Los simbolos deben ser ascii");
+        }
+        if ( af->en_alfabeto[simbolos[ai]] ) {
+            panico("Simbolo repetido en el marco binario");
+        }
+        af->en_alfabeto[simbolos[ai]] = 1;
+    }
+    for ( uint32_t q = 0; q < n; ++q ) {
+        af->finales[q] = q ? (finales[q] != 0) : 0;
+        for ( uint32_t ai = 0; ai < ns && q; ++ai ) {
+            uint32_t d = leer_u32(destinos + 4 * ((size_t)q * ns + ai));
+            if ( d >= n ) {
+                panico("Estado invalido\n");
+            }
+            af->tabla[q][simbolos[ai]] = (estado_t)d;
+        }
+    }
+    af->num_estados = (int)n;
+    af_cerrar(af, temp);
+}
+
+static void servidor_responder(Servidor* sv, Trabajo* t, const char* encabezado, int64_t latencia)
+{
+    size_t largo_encabezado = strlen(encabezado);
+    size_t largo = largo_encabezado + sb_count(t->respuesta);
+    uint8_t marco[8];
+    escribir_u32(marco, t->id);
+    escribir_u32(marco + 4, (uint32_t)largo);
+    sgl_mutex_lock(sv->mutex_salida);
+    if ( sv->cortada ) {
+        sgl_mutex_unlock(sv->mutex_salida);
+        return;
+    }
+    int ok = escribir_exacto(sv->salida, marco, sizeof(marco)) &&
+             escribir_exacto(sv->salida, encabezado, largo_encabezado) &&
+             escribir_exacto(sv->salida, t->respuesta, sb_count(t->respuesta));
+    int error = errno;
+    if ( ok ) {
+        sv->num_peticiones++;
+        sv->latencia_total += latencia;
+        if ( latencia > sv->latencia_max ) {
+            sv->latencia_max = latencia;
+        }
+    } else {
+        sv->cortada = 1;
+    }
+    sgl_mutex_unlock(sv->mutex_salida);
+    if ( !ok && error != EPIPE && error != ECONNRESET ) {
+        fprintf(stderr, "ERROR: no se pudo escribir la respuesta %u\n", t->id);
+    }
+}
+
+static void servidor_trabajador(void* param)
+{
+    Trabajador* tr = (Trabajador*)param;
+    Servidor* sv = tr->sv;
+    Trabajo* t;
+    while ( (t = cola_sacar(&sv->pendientes)) != NULL ) {
+        if ( t->respuesta ) {
+            sgl__sbcount(t->respuesta) = 0;
+        }
+        char encabezado[256];
+        jmp_buf rescate;
+        arena_reset(tr->arena);
+        if ( servidor_cortada(sv) ) {
+            // Nadie va a leer la respuesta.
+            cola_meter(&sv->libres, t);
+            continue;
+        }
+        if ( !t->leido ) {
+            snprintf(encabezado, sizeof(encabezado), "error El marco es demasiado grande\n");
+        } else if ( setjmp(rescate) == 0 ) {
+            g_rescate = &rescate;
+            if ( t->largo >= 4 && memcmp(t->contenido, "P01B", 4) == 0 ) {
+                cargar_af_binario(&t->af, (uint8_t*)t->contenido, t->largo, tr->arena);
+            } else {
+                LectorAF lector;
+                lector_af_iniciar(&lector, &t->af);
+                lector_af_agregar(&lector, t->contenido, t->largo);
+                lector_af_terminar(&lector, tr->arena);
+            }
+            minimizar(&t->af, &t->min, tr->arena);
+            g_rescate = NULL;
+            imprimir_resultado(&t->af, &t->min, &t->respuesta);
+            snprintf(encabezado, sizeof(encabezado), "ok %" PRId64 "\n", sgl_get_time_us() - t->inicio);
+        } else {
+            g_rescate = NULL;
+            char mensaje[200];
+            snprintf(mensaje, sizeof(mensaje), "%s", g_mensaje_panico);
+            snprintf(encabezado, sizeof(encabezado), "error %s\n", sgl_strip_whitespace_inplace(mensaje));
+        }
+        servidor_responder(sv, t, encabezado, sgl_get_time_us() - t->inicio);
+        cola_meter(&sv->libres, t);
+    }
+}
+
+// Lee marcos de fd hasta que se acabe o se corte, y espera a que se
+// contesten (o descarten) todos.
+static void servidor_atender(Servidor* sv, int fd)
+{
+    uint8_t marco[8];
+    sv->salida = fd == STDIN_FILENO ? STDOUT_FILENO : fd;
+    sv->cortada = 0;
+    while ( !g_parar_servidor && !servidor_cortada(sv) && leer_exacto(fd, marco, sizeof(marco)) ) {
+        Trabajo* t = cola_sacar(&sv->libres);
+        t->id = leer_u32(marco);
+        uint32_t largo = leer_u32(marco + 4);
+        t->largo = largo;
+        t->leido = largo <= MAX_MARCO;
+        if ( t->leido ) {
+            if ( t->capacidad < (size_t)largo + 1 ) {
+                t->capacidad = (size_t)largo + 1;
+                t->contenido = (char*)sgl_realloc(t->contenido, t->capacidad);
+                if ( !t->contenido ) {
+                    panico("No hay memoria para leer la peticion");
+                }
+            }
+            if ( !leer_exacto(fd, t->contenido, largo) ) {
+                cola_meter(&sv->libres, t);
+                break;
+            }
+            t->contenido[largo] = '\0';
+        } else {
+            // Descartar el contenido, de a poco.
+            char basura[4096];
+            for ( uint32_t r = largo; r; ) {
+                uint32_t n = r < sizeof(basura) ? r : (uint32_t)sizeof(basura);
+                if ( !leer_exacto(fd, basura, n) ) {
+                    break;
+                }
+                r -= n;
+            }
+        }
+        t->inicio = sgl_get_time_us();
+        cola_meter(&sv->pendientes, t);
+    }
+    // Esperar a que regresen todos los trabajos.
+    Trabajo* libres[NUM_TRABAJOS];
+    for ( int i = 0; i < NUM_TRABAJOS; ++i ) {
+        libres[i] = cola_sacar(&sv->libres);
+    }
+    for ( int i = 0; i < NUM_TRABAJOS; ++i ) {
+        cola_meter(&sv->libres, libres[i]);
+    }
+}
+
+// Sin socket, atiende la entrada estandar y termina cuando se acaba.
+static void procesar_servidor(char* path_socket)
+{
+    static Servidor sv;
+    static Trabajador trabajadores[NUM_TRABAJOS];
+    SglThread* hilos[NUM_TRABAJOS];
+    cola_iniciar(&sv.libres);
+    cola_iniciar(&sv.pendientes);
+    sv.mutex_salida = sgl_create_mutex();
+    if ( !sv.mutex_salida ) {
+        panico("No se pudo iniciar el servidor");
+    }
+
+    if ( pipe(g_pipe_senal) != 0 ) {
+        panico("No se pudo iniciar el servidor");
+    }
+    for ( int i = 0; i < 2; ++i ) {
+        fcntl(g_pipe_senal[i], F_SETFL, fcntl(g_pipe_senal[i], F_GETFL) | O_NONBLOCK);
+        fcntl(g_pipe_senal[i], F_SETFD, FD_CLOEXEC);
+    }
+    // Sin SA_RESTART, para que la senal tambien interrumpa poll().
+    struct sigaction accion;
+    memset(&accion, 0, sizeof(accion));
+    accion.sa_handler = servidor_senal;
+    sigemptyset(&accion.sa_mask);
+    sigaction(SIGTERM, &accion, NULL);
+    sigaction(SIGINT, &accion, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Los trabajadores heredan las senales bloqueadas, asi que solo el hilo
+    // principal las recibe.
+    sigset_t senales;
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGTERM);
+    sigaddset(&senales, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &senales, NULL);
+    for ( int i = 0; i < NUM_TRABAJOS; ++i ) {
+        cola_meter(&sv.libres, &sv.trabajos[i]);
+        sv.arenas[i] = crear_arena(TAM_ARENA_HILO);
+        trabajadores[i].sv = &sv;
+        trabajadores[i].arena = &sv.arenas[i];
+        hilos[i] = sgl_create_thread(servidor_trabajador, &trabajadores[i]);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &senales, NULL);
+
+    if ( !path_socket ) {
+        servidor_atender(&sv, STDIN_FILENO);
+    } else {
+        int s = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un dir;
+        memset(&dir, 0, sizeof(dir));
+        dir.sun_family = AF_UNIX;
+        if ( s < 0 || strlen(path_socket) >= sizeof(dir.sun_path) ) {
+            panico("No se pudo crear el socket");
+        }
+        strcpy(dir.sun_path, path_socket);
+        unlink(path_socket);
+        if ( bind(s, (struct sockaddr*)&dir, sizeof(dir)) != 0 || listen(s, 16) != 0 ) {
+            panico("No se pudo escuchar en el socket");
+        }
+        fprintf(stderr, "Escuchando en %s\n", path_socket);
+        // Una conexion a la vez; dentro de cada una las peticiones se atienden en paralelo.
+        while ( esperar_entrada(s) ) {
+            int c = accept(s, NULL, NULL);
+            if ( c < 0 ) {
+                continue;
+            }
+            servidor_atender(&sv, c);
+            close(c);
+        }
+        close(s);
+        unlink(path_socket);
+    }
+
+    for ( int i = 0; i < NUM_TRABAJOS; ++i ) {
+        cola_meter(&sv.pendientes, NULL);
+    }
+    for ( int i = 0; i < NUM_TRABAJOS; ++i ) {
+        sgl_join_thread(hilos[i]);
+    }
+    if ( sv.num_peticiones ) {
+        fprintf(stderr, "%" PRId64 " peticiones, latencia promedio %" PRId64 " us, maxima %" PRId64 " us\n",
+                sv.num_peticiones, sv.latencia_total / sv.num_peticiones, sv.latencia_max);
+    }
+}
+
+#else  // Sin servidor en otras plataformas.
+
+static void procesar_servidor(char* path_socket)
+{
+    panico("El servidor solo esta disponible en Linux y macOS.");
+}
+
+#endif
+
+// arnes.c incluye este archivo sin main().
+#ifndef P01_SIN_MAIN
+int main(int argc, char** argv)
+{
+    mem_init(TAM_MEMORIA);
+
+    static char* test_fa [] = {
+        "af0.csv",
+        "af1.csv",
+    };
+
+    if ( argc == 4 && strcmp(argv[1], "--equiv") == 0 ) {
+        int res = procesar_equivalencia(argv[2], argv[3]);
+        mem_deinit();
+        return res ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if ( (argc == 2 || argc == 3) && strcmp(argv[1], "--servidor") == 0 ) {
+        procesar_servidor(argc == 3 ? argv[2] : NULL);
+        mem_deinit();
+        return EXIT_SUCCESS;
+    }
+    if ( argc == 4 && strcmp(argv[1], "--incremental") == 0 ) {
+        procesar_incremental(argv[2], argv[3]);
+        mem_deinit();
+        return EXIT_SUCCESS;
+    }
+
+    int usar_pipeline = 0;
+    int producto = -1;
+    int patrones = 0;
+    int externo = 0;
+    size_t memoria_externa = MEMORIA_EXTERNA;
+    char* dir_temporal = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char* path_entrada = NULL;
+    char* dir_cache = NULL;
+    int64_t limite_cache = CACHE_LIMITE;
+    char** paths = NULL;
+    char** expresiones = NULL;
+    char* path_traza = NULL;
+    char* nombre_c = NULL;
+    for ( int i = 1; i < argc; ++i ) {
+        if ( strcmp(argv[i], "--pipeline") == 0 ) {
+            usar_pipeline = 1;
+        } else if ( strcmp(argv[i], "--externo") == 0 ) {
+            externo = 1;
+        } else if ( strcmp(argv[i], "--memoria") == 0 && i + 1 < argc ) {
+            memoria_externa = (size_t)strtoll(argv[++i], NULL, 10) * 1024 * 1024;
+        } else if ( strcmp(argv[i], "--tmp") == 0 && i + 1 < argc ) {
+            dir_temporal = argv[++i];
+        } else if ( strcmp(argv[i], "--patrones") == 0 ) {
+            patrones = 1;
+        } else if ( strcmp(argv[i], "--entrada") == 0 && i + 1 < argc ) {
+            path_entrada = argv[++i];
+        } else if ( strcmp(argv[i], "--producto") == 0 && i + 1 < argc ) {
+            char* op = argv[++i];
+            if ( strcmp(op, "inter") == 0 ) {
+                producto = PRODUCTO_inter;
+            } else if ( strcmp(op, "union") == 0 ) {
+                producto = PRODUCTO_union;
+            } else if ( strcmp(op, "dif") == 0 ) {
+                producto = PRODUCTO_dif;
+            } else {
+                panico("Operacion desconocida (debe ser inter, union o dif).");
+            }
+        } else if ( strcmp(argv[i], "--cache") == 0 && i + 1 < argc ) {
+            dir_cache = argv[++i];
+        } else if ( strcmp(argv[i], "--cache-limite") == 0 && i + 1 < argc ) {
+            limite_cache = strtoll(argv[++i], NULL, 10);
+        } else if ( strcmp(argv[i], "--canonico") == 0 ) {
+            g_opciones.canonico = 1;
+        } else if ( strcmp(argv[i], "--dedup") == 0 ) {
+            g_opciones.dedup = 1;
+        } else if ( strcmp(argv[i], "--motor") == 0 && i + 1 < argc ) {
+            char* motor = argv[++i];
+            if ( strcmp(motor, "tabla") == 0 ) {
+                g_opciones.motor = MOTOR_tabla;
+            } else if ( strcmp(motor, "bits") == 0 ) {
+                g_opciones.motor = MOTOR_bits;
+            } else {
+                panico("Motor desconocido (debe ser tabla o bits).");
+            }
+        } else if ( strcmp(argv[i], "--orden") == 0 && i + 1 < argc ) {
+            char* orden = argv[++i];
+            if ( strcmp(orden, "bfs") == 0 ) {
+                g_opciones.orden = ORDEN_bfs;
+            } else if ( strcmp(orden, "dfs") == 0 ) {
+                g_opciones.orden = ORDEN_dfs;
+            } else if ( strncmp(orden, "perfil:", 7) == 0 && orden[7] ) {
+                g_opciones.orden = ORDEN_perfil;
+                g_opciones.perfil = orden + 7;
+            } else {
+                panico("Orden desconocido (debe ser bfs, dfs o perfil:ARCHIVO).");
+            }
+        } else if ( strcmp(argv[i], "--emitir-c") == 0 && i + 1 < argc ) {
+            nombre_c = argv[++i];
+        } else if ( strcmp(argv[i], "--perf") == 0 ) {
+            g_medicion.perf = 1;
+        } else if ( strcmp(argv[i], "--traza") == 0 && i + 1 < argc ) {
+            path_traza = argv[++i];
+        } else if ( strcmp(argv[i], "--regex") == 0 && i + 1 < argc ) {
+            sb_push(expresiones, argv[++i]);
+        } else if ( strcmp(argv[i], "--probar") == 0 && i + 1 < argc ) {
+            sb_push(g_opciones.pruebas, argv[++i]);
+        } else if ( argv[i][0] == '-' && argv[i][1] == '-' ) {
+            panico("Opcion desconocida");
+        } else {
+            sb_push(paths, argv[i]);
+        }
+    }
+    if ( g_medicion.perf ) {
+        g_medicion.mutex = sgl_create_mutex();
+        if ( !g_medicion.mutex ) {
+            panico("No se pudo crear el mutex de la medicion");
+        }
+    }
+    if ( path_traza ) {
+        sgl_trace_enable();
+        g_medicion.traza = sgl_trace_enabled();
+    }
+
+    int num_paths = sb_count(paths);
+    if ( nombre_c ) {
+        if ( num_paths != 1 && num_paths != 2 ) {
+            panico("--emitir-c necesita el archivo del automata y, opcionalmente, el del header.");
+        }
+        procesar_emitir_c(nombre_c, paths[0], num_paths == 2 ? paths[1] : NULL);
+        mem_deinit();
+        return EXIT_SUCCESS;
+    }
+    if ( externo ) {
+        if ( num_paths != 2 ) {
+            panico("--externo necesita el archivo de entrada y el de salida.");
+        }
+        procesar_externo(paths[0], paths[1], dir_temporal, memoria_externa);
+        mem_deinit();
+        return EXIT_SUCCESS;
+    }
+    if ( !num_paths && !sb_count(expresiones) ) {
+        paths = test_fa;
+        num_paths = sgl_array_count(test_fa);
+    }
+
+    if ( sb_count(g_opciones.pruebas) || g_opciones.orden != ORDEN_descubrimiento ) {
+        g_opciones.arena_salida = crear_arena(TAM_ARENA_HILO);
+    }
+
+    static Cache cache;
+    if ( dir_cache ) {
+        cache_iniciar(&cache, dir_cache, limite_cache);
+        g_opciones.cache = &cache;
+    }
+
+    if ( sb_count(expresiones) ) {
+        procesar_expresiones(expresiones, sb_count(expresiones));
+    }
+    if ( !num_paths ) {
+        // Solo expresiones.
+    } else if ( patrones ) {
+        procesar_patrones(paths, num_paths, path_entrada);
+    } else if ( producto >= 0 ) {
+        procesar_producto(paths, num_paths, producto);
+    } else if ( usar_pipeline ) {
+        procesar_pipeline(paths, num_paths);
+    } else {
+        procesar_secuencial(paths, num_paths);
+    }
+
+    if ( g_medicion.perf ) {
+        imprimir_medicion();
+    }
+    if ( path_traza && sgl_trace_write(path_traza) != 0 ) {
+        panico("No se pudo escribir la traza");
     }
 
     mem_deinit();
     return EXIT_SUCCESS;
 }
+#endif  // P01_SIN_MAIN